@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// the binary layout the theme and plugin caches share: native byte order
+// integers and length prefixed strings. each cache adds its own magic and
+// version in front
+namespace cache_io {
+
+inline void write_u32(std::ostream& os, uint32_t v) {
+  os.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+inline void write_u64(std::ostream& os, uint64_t v) {
+  os.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+inline void write_str(std::ostream& os, const std::string& s) {
+  write_u32(os, (uint32_t)s.size());
+  os.write(s.data(), s.size());
+}
+inline void write_strs(std::ostream& os, const std::vector<std::string>& v) {
+  write_u32(os, (uint32_t)v.size());
+  for (auto& s : v) write_str(os, s);
+}
+
+// bounds checked reader over a loaded cache file
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : data_(data) {}
+  bool u32(uint32_t& v) { return raw(&v, sizeof(v)); }
+  bool u64(uint64_t& v) { return raw(&v, sizeof(v)); }
+  bool str(std::string& s) {
+    uint32_t len;
+    if (!u32(len) || len > data_.size() - pos_) return false;
+    s.assign(data_, pos_, len);
+    pos_ += len;
+    return true;
+  }
+  bool strs(std::vector<std::string>& v) {
+    uint32_t count;
+    if (!u32(count)) return false;
+    for (uint32_t i = 0; i < count; ++i) {
+      std::string s;
+      if (!str(s)) return false;
+      v.push_back(std::move(s));
+    }
+    return true;
+  }
+  bool raw(void* out, size_t len) {
+    if (len > data_.size() - pos_) return false;
+    std::memcpy(out, data_.data() + pos_, len);
+    pos_ += len;
+    return true;
+  }
+
+ private:
+  const std::string& data_;
+  size_t pos_ = 0;
+};
+
+}  // namespace cache_io
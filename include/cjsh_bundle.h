@@ -0,0 +1,17 @@
+#pragma once
+
+// one file archive of a user's cjsh setup: .cjshrc, .cjprofile and the
+// themes, plugins and colors directories. the manifest comes first and is
+// checksummed, every file carries its sha256 and file data is streamed
+// between descriptors by the kernel, so a bundle can go through a pipe
+namespace cjsh_bundle {
+
+// writes the bundle to fd in a single sequential pass
+bool export_bundle(int fd);
+
+// reads a bundle from fd into a staging area, verifies it and only then
+// swaps the bundled files and directories into place. on any failure the
+// existing setup is left as it was
+bool import_bundle(int fd);
+
+}  // namespace cjsh_bundle
@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <unistd.h>
 
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <vector>
@@ -61,6 +62,64 @@ const fs::path g_cjsh_found_executables_path =
     g_cjsh_cache_path /
     "cached_executables.txt";  // where the found executables are stored for
                                // syntax highlighting and completions
+
+const fs::path g_cjsh_executable_dirs_path =
+    g_cjsh_cache_path /
+    "executables";  // per PATH directory scans, overlays the system cache
+
+const fs::path g_cjsh_system_cache_path =
+    "/var/cache/cjsh";  // shared by every user on the host
+const fs::path g_cjsh_system_executable_dirs_path =
+    g_cjsh_system_cache_path /
+    "executables";  // per PATH directory scans written by whoever may
+
+const fs::path g_cjsh_store_path =
+    g_cjsh_cache_path / "objects";  // content addressed themes and plugins
+const fs::path g_cjsh_system_store_path =
+    g_cjsh_system_cache_path / "objects";  // shared store, used if writable
+const fs::path g_cjsh_store_refs_path =
+    g_cjsh_cache_path /
+    "store_refs.txt";  // which object is installed at which path
+
+const fs::path g_cjsh_theme_cache_path =
+    g_cjsh_cache_path /
+    "themes.cache";  // parsed themes for the picker, see theme_preview
+
+const fs::path g_cjsh_plugin_cache_path =
+    g_cjsh_cache_path /
+    "plugins.cache";  // inspected plugins, see plugin_inspector
+
+const fs::path g_cjsh_snapshot_path =
+    g_cjsh_cache_path /
+    "startup.snapshot";  // compiled .cjprofile and .cjshrc, see cjsh_snapshot
+
+// what a cache needs to tell whether a file changed since it was read
+struct FileStamp {
+  uint64_t device = 0;
+  uint64_t inode = 0;
+  int64_t mtime = 0;  // nanoseconds since the epoch
+  uint64_t size = 0;
+  bool directory = false;
+};
+
+// stats path, following symlinks. false if it does not exist
+bool file_stamp(const fs::path& path, FileStamp& stamp);
+
+bool should_refresh_executable_cache();
+
+// each PATH directory's listing is read from the system cache, then from
+// the user's cache, and scanned only when neither is current. listings of
+// root owned, world readable directories go to the system cache when root
+// builds them, every other listing stays in the user's cache
+bool build_executable_cache();
+std::vector<fs::path> read_cached_executables();
+
+// creates the shared executables and objects directories under
+// g_cjsh_system_cache_path and lists the standard system bin directories
+// into it. needs root, run once per host with
+// `cjsh-configure init-system-cache`. only root writes there, other users
+// read it and keep everything else in their own cache
+bool initialize_system_cache();
 }  // namespace cjsh_filesystem
 bool initialize_cjsh_path();
 bool initialize_cjsh_directories();
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// precompiled form of ~/.cjprofile and ~/.cjshrc so cjsh can mmap its startup
+// state instead of reparsing the text files on every spawn
+namespace cjsh_snapshot {
+namespace fs = std::filesystem;
+
+constexpr char kMagic[8] = {'C', 'J', 'S', 'H', 'S', 'N', 'P', '\0'};
+constexpr uint32_t kVersion = 2;
+
+// entries keep their file order. ~/.cjprofile is only read by login shells
+// and before ~/.cjshrc, so for a duplicate name the ~/.cjshrc entry wins in
+// an interactive login shell, and the last entry wins within one file
+enum Section : uint32_t {
+  kAliases = 0,          // key = name, value = command, from ~/.cjshrc
+  kExports,              // key = variable, value = value, from ~/.cjshrc
+  kProfileAliases,       // like kAliases, from ~/.cjprofile
+  kProfileExports,       // like kExports, from ~/.cjprofile
+  kTheme,                // key = theme name
+  kPlugins,              // key = plugin name
+  kStartupCommands,      // key = command line from ~/.cjshrc
+  kProfileCommands,      // key = command line from ~/.cjprofile
+  kStartupArgs,          // key = argument from ~/.cjprofile
+  kSectionCount
+};
+
+// on disk layout, native byte order. every offset is from the start of the
+// file and every table is 8 byte aligned so the file can be used in place
+struct StrRef {
+  uint32_t offset;  // into the string table
+  uint32_t length;
+};
+struct Entry {
+  StrRef key;
+  StrRef value;
+};
+struct SectionRef {
+  uint64_t offset;  // of the first Entry
+  uint32_t count;
+  uint32_t reserved;
+};
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t section_count;
+  uint64_t source_hash;  // source_hash() of the files it was compiled from
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  SectionRef sections[kSectionCount];
+};
+
+// FNV-1a over the profile and rc contents, missing files hash as empty
+uint64_t source_hash(const fs::path& profile, const fs::path& rc);
+
+// parses both files and atomically replaces the snapshot at out
+bool compile(const fs::path& profile, const fs::path& rc, const fs::path& out);
+bool compile();  // the default cjsh paths
+
+// read only view of a snapshot file
+class Snapshot {
+ public:
+  Snapshot() = default;
+  ~Snapshot();
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  // maps and validates the file, false if missing, truncated or another
+  // format version
+  bool open(const fs::path& path);
+  void close();
+
+  uint64_t source_hash() const;
+  size_t count(Section section) const;
+  std::string_view key(Section section, size_t i) const;
+  std::string_view value(Section section, size_t i) const;
+
+ private:
+  std::string_view str(const StrRef& ref) const;
+  const Entry* entries(Section section) const;
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// true when the snapshot is missing, unreadable or was compiled from sources
+// that have changed since
+bool is_stale(const fs::path& snapshot, const fs::path& profile,
+              const fs::path& rc);
+bool is_stale();
+
+}  // namespace cjsh_snapshot
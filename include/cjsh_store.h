@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// content addressed store for downloaded themes and plugins. installed files
+// are hardlinks or reflinks of read only objects, so identical artifacts take
+// space once and a removed item can be put back without downloading it again
+namespace cjsh_store {
+namespace fs = std::filesystem;
+
+// hex sha256 of the file contents, empty if it cannot be read
+std::string hash_file(const fs::path& path);
+
+// hex sha256 of a buffer
+std::string hash_bytes(const void* data, size_t len);
+
+// adds source to the store and links the object to dest, replacing dest
+bool install(const fs::path& source, const fs::path& dest);
+
+// relinks the object last installed at dest, false if it is not in the store
+bool restore(const fs::path& dest);
+
+// removes dest, its object stays in the store until collect_garbage()
+bool uninstall(const fs::path& dest);
+
+struct GcStats {
+  size_t objects_removed = 0;
+  uintmax_t bytes_freed = 0;
+};
+
+// drops objects that nothing is installed from anymore, from the user's store
+// and those the user owns in the shared store. only root adds to the shared
+// store, since other users ignore objects anyone else owns there
+GcStats collect_garbage();
+
+}  // namespace cjsh_store
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tui {
+
+// single-threaded reactor multiplexing the keyboard, file watches, timers and
+// completions posted from worker threads. screens are a draw handler plus a
+// key handler run on top of it; run() may be nested for sub screens.
+class EventLoop {
+ public:
+  using Callback = std::function<void()>;
+  using DrawHandler = std::function<void()>;
+  using KeyHandler = std::function<bool(int)>;  // return false to leave run()
+
+  static EventLoop& instance();
+
+  // dispatches events until on_key returns false. draw is called whenever the
+  // screen is marked dirty, which happens after every key and on
+  // request_redraw()
+  void run(const DrawHandler& draw, const KeyHandler& on_key);
+  void request_redraw();
+  // leaves the innermost run() once the current event is handled
+  void quit();
+
+  int add_timer(std::chrono::milliseconds delay, Callback cb,
+                bool repeat = false);
+  void cancel_timer(int id);
+
+  // fires cb when path (a file or a directory's entries) changes on disk
+  int add_watch(const std::filesystem::path& path, Callback cb);
+  void remove_watch(int id);
+
+  // thread safe, cb runs on the loop thread. dropped once the loop is
+  // shutting down
+  void post(Callback cb);
+
+  // runs work on a worker thread the loop owns, call from the loop thread.
+  // dropped once the loop is shutting down
+  void spawn(Callback work);
+
+  // drops posted callbacks from now on and joins every worker. call it when
+  // the UI is done, before main returns: a worker still running once static
+  // destruction starts could use objects that are already gone
+  void shutdown();
+
+ private:
+  EventLoop();
+  ~EventLoop();
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  struct Timer {
+    int id;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::milliseconds interval;
+    bool repeat;
+    Callback cb;
+  };
+  struct Watch {
+    int id;
+    int wd;            // inotify descriptor of the watched directory
+    std::string name;  // entry inside the directory, empty for any entry
+    std::filesystem::path path;
+    std::filesystem::file_time_type mtime;  // used without inotify
+    Callback cb;
+  };
+
+  void dispatch_once(const KeyHandler& on_key, bool& done);
+  bool drain_keys(const KeyHandler& on_key, bool& done);
+  int next_timeout_ms() const;
+  void fire_timers();
+  void handle_inotify();
+  void check_watches_by_mtime();
+  void drain_posted();
+  void reap_workers();
+
+  int next_id_ = 1;
+  bool dirty_ = true;
+  bool quit_ = false;
+  int wake_pipe_[2] = {-1, -1};
+  int inotify_fd_ = -1;
+  int mtime_timer_ = 0;
+  std::vector<Timer> timers_;
+  std::vector<Watch> watches_;
+  std::mutex posted_mutex_;
+  std::vector<Callback> posted_;
+  bool stopping_ = false;  // guarded by posted_mutex_
+  struct Worker {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> finished;
+  };
+  std::vector<Worker> workers_;
+};
+
+// runs work on a worker thread and done(result) back on the loop thread
+template <typename T>
+void run_in_background(std::function<T()> work, std::function<void(T)> done) {
+  EventLoop& loop = EventLoop::instance();
+  loop.spawn([&loop, work = std::move(work), done = std::move(done)]() {
+    auto result = std::make_shared<T>(work());
+    loop.post([done, result]() { done(std::move(*result)); });
+  });
+}
+
+}  // namespace tui
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+
+// finds commands worth aliasing in the cjsh history. the file is mapped and
+// counted in parallel chunks with bounded heavy hitter summaries, so memory
+// does not grow with the size of the history
+namespace history_suggest {
+namespace fs = std::filesystem;
+
+struct Suggestion {
+  std::string alias;    // proposed name, not in taken_names
+  std::string command;  // full command line or its leading words
+  uint64_t count = 0;   // lower bound on how often it was typed
+  bool prefix = false;  // command is the start of longer lines
+};
+
+struct Options {
+  size_t max_results = 20;
+  size_t min_command_length = 12;  // shorter lines are not worth an alias
+  size_t min_prefix_length = 8;
+  uint64_t min_count = 3;
+  size_t capacity = 4096;  // counters per summary, bounds memory
+  unsigned threads = 0;    // 0 for one per core
+};
+
+// taken_names are existing aliases and executables, aliased_commands are
+// commands that already have an alias and are skipped
+std::vector<Suggestion> suggest(const fs::path& history, const Options& options,
+                                const std::set<std::string>& taken_names,
+                                const std::set<std::string>& aliased_commands);
+
+}  // namespace history_suggest
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// line diff using Myers' O(ND) algorithm in its linear space, divide and
+// conquer form, grouped into unified diff hunks. regions that would cost it
+// too many edits are split on lines unique to both sides, as patience diff
+// does, so shuffled or reordered files stay fast
+namespace line_diff {
+
+struct Hunk {
+  size_t old_start = 0;  // 0 based, context lines included
+  size_t old_count = 0;
+  size_t new_start = 0;
+  size_t new_count = 0;
+  std::vector<std::string> lines;  // prefixed with ' ', '-' or '+'
+
+  std::string header() const;  // "@@ -a,b +c,d @@", 1 based like diff -u
+};
+
+std::vector<Hunk> diff(const std::vector<std::string>& old_lines,
+                       const std::vector<std::string>& new_lines,
+                       size_t context = 3);
+
+// old_lines with the accepted hunks taken from new_lines
+std::vector<std::string> apply(const std::vector<std::string>& old_lines,
+                               const std::vector<std::string>& new_lines,
+                               const std::vector<Hunk>& hunks,
+                               const std::vector<bool>& accepted);
+
+}  // namespace line_diff
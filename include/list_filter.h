@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// filter as you type over a fixed list. items are lowercased once into a
+// single buffer, and a query that extends the previous one only searches
+// the previous matches, so typing stays cheap on very long lists
+namespace list_filter {
+
+class Filter {
+ public:
+  explicit Filter(const std::vector<std::string>& items);
+
+  // indices of the items containing every space separated word of query,
+  // ignoring case, in list order. an empty query matches everything
+  const std::vector<size_t>& update(const std::string& query);
+
+  const std::vector<size_t>& matches() const { return matches_; }
+  size_t size() const { return offsets_.size() - 1; }
+
+ private:
+  std::string_view item(size_t i) const {
+    return std::string_view(text_).substr(offsets_[i],
+                                          offsets_[i + 1] - offsets_[i]);
+  }
+
+  std::string text_;             // every item, normalized, back to back
+  std::vector<size_t> offsets_;  // item i is [offsets_[i], offsets_[i + 1])
+  std::string query_;            // normalized query matches_ is for
+  std::vector<size_t> matches_;
+};
+
+}  // namespace list_filter
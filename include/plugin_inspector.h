@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// reads installed plugins straight from their ELF headers and dynamic symbol
+// tables without dlopen, so broken plugins show up before cjsh loads them
+namespace plugin_inspector {
+namespace fs = std::filesystem;
+
+struct PluginInfo {
+  fs::path path;
+  uintmax_t size = 0;
+  std::string format;  // "ELF64", "ELF32", "Mach-O" or "unknown"
+  std::string arch;
+  bool arch_matches_host = false;
+  std::vector<std::string> entry_points;          // exported plugin_* symbols
+  std::vector<std::string> missing_entry_points;  // required but not exported
+  std::vector<std::string> needed;                // DT_NEEDED libraries
+  std::vector<std::string> runpaths;  // DT_RUNPATH and DT_RPATH entries
+  std::vector<std::string> missing_deps;          // needed but not found
+  std::string error;  // set when the file could not be parsed
+
+  bool ok() const {
+    return error.empty() && arch_matches_host &&
+           missing_entry_points.empty() && missing_deps.empty();
+  }
+};
+
+// symbols cjsh resolves when it loads a plugin
+extern const std::vector<std::string> required_entry_points;
+
+PluginInfo inspect(const fs::path& path);
+
+// inspects every .so/.dylib in dir on a pool of threads. results are cached
+// in g_cjsh_plugin_cache_path by inode, mtime and size, so only new or
+// changed plugins are parsed again. missing_deps is always checked afresh
+// since libraries come and go without the plugin changing
+std::vector<PluginInfo> inspect_directory(const fs::path& dir);
+
+}  // namespace plugin_inspector
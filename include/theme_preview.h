@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// the parts of a cjsh theme needed to preview its prompt
+namespace theme_preview {
+namespace fs = std::filesystem;
+
+struct Segment {
+  std::string content;  // may hold placeholders like {USERNAME}
+  std::string fg_color;
+  std::string bg_color;
+  std::string separator;
+  std::string separator_fg;
+  std::string separator_bg;
+};
+
+struct ParsedTheme {
+  int64_t mtime = 0;  // of the source file, for invalidation
+  uint64_t size = 0;
+  std::vector<Segment> segments;  // ps1_segments in order
+};
+
+// reads the ps1_segments array of a theme file
+ParsedTheme parse_theme(const fs::path& path);
+
+// parsed themes kept in a compact binary file so reopening the picker does
+// not parse anything that has not changed on disk
+class ThemeCache {
+ public:
+  explicit ThemeCache(fs::path cache_file);
+  ~ThemeCache();  // saves if anything was parsed or deleted
+
+  // parses path only if it is new or its mtime or size changed
+  const ParsedTheme& get(const fs::path& path);
+  // writes the cache, leaving out themes whose file is gone
+  bool save();
+
+ private:
+  void load();
+  bool prune();
+
+  fs::path cache_file_;
+  std::map<std::string, ParsedTheme> themes_;
+  bool dirty_ = false;
+};
+
+// "#rrggbb" or a color name, into 8 bit r g b. false if unknown or RESET
+bool color_rgb(const std::string& color, int& r, int& g, int& b);
+
+// replaces {PLACEHOLDERS} with sample values for the preview
+std::string sample_content(const std::string& content);
+
+}  // namespace theme_preview
@@ -0,0 +1,476 @@
+#include "../include/cjsh_bundle.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/cjsh_filesystem.h"
+#include "../include/cjsh_store.h"
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace cjsh_bundle {
+
+namespace fs = cjsh_filesystem::fs;
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'J', 'S', 'H', 'B', 'D', 'L', '\0'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 24;  // magic, version, count, manifest size
+constexpr size_t kHashSize = 64;    // hex sha256
+constexpr uint64_t kMaxManifest = 64 << 20;
+
+enum Kind : uint8_t { kFile = 0, kDirectory = 1, kSymlink = 2 };
+
+// path is relative and starts with "home/" or "data/"
+struct Entry {
+  Kind kind;
+  uint32_t mode = 0;
+  uint64_t size = 0;
+  std::string hash;    // files only
+  std::string path;
+  std::string target;  // symlinks only
+  fs::path source;     // export only
+};
+
+// bundled roots, everything else in a bundle is refused
+struct Root {
+  const char* name;
+  fs::path path;
+};
+const std::vector<Root>& roots() {
+  static const std::vector<Root> r = {
+      {"home/.cjshrc", cjsh_filesystem::g_cjsh_source_path},
+      {"home/.cjprofile", cjsh_filesystem::g_cjsh_profile_path},
+      {"data/themes", cjsh_filesystem::g_cjsh_theme_path},
+      {"data/plugins", cjsh_filesystem::g_cjsh_plugin_path},
+      {"data/colors", cjsh_filesystem::g_cjsh_colors_path}};
+  return r;
+}
+
+void fail(const std::string& message) {
+  std::cerr << "cjsh bundle: " << message << std::endl;
+}
+
+// integers are little endian so bundles move between hosts
+void put_u32(std::string& out, uint32_t v) {
+  for (int i = 0; i < 4; ++i) out += (char)(v >> (8 * i));
+}
+void put_u64(std::string& out, uint64_t v) {
+  for (int i = 0; i < 8; ++i) out += (char)(v >> (8 * i));
+}
+void put_str(std::string& out, const std::string& s) {
+  put_u32(out, (uint32_t)s.size());
+  out += s;
+}
+
+class Reader {
+ public:
+  Reader(const char* data, size_t size) : data_(data), size_(size) {}
+  bool u8(uint8_t& v) {
+    if (size_ - pos_ < 1) return false;
+    v = (uint8_t)data_[pos_++];
+    return true;
+  }
+  bool u32(uint32_t& v) {
+    uint64_t wide;
+    if (!uint(4, wide)) return false;
+    v = (uint32_t)wide;
+    return true;
+  }
+  bool u64(uint64_t& v) { return uint(8, v); }
+  bool bytes(size_t len, std::string& s) {
+    if (size_ - pos_ < len) return false;
+    s.assign(data_ + pos_, len);
+    pos_ += len;
+    return true;
+  }
+  bool str(std::string& s) {
+    uint32_t len;
+    return u32(len) && bytes(len, s);
+  }
+  bool done() const { return pos_ == size_; }
+
+ private:
+  bool uint(int width, uint64_t& v) {
+    if (size_ - pos_ < (size_t)width) return false;
+    v = 0;
+    for (int i = 0; i < width; ++i)
+      v |= (uint64_t)(unsigned char)data_[pos_ + i] << (8 * i);
+    pos_ += width;
+    return true;
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t pos_ = 0;
+};
+
+bool write_all(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool read_all(int fd, char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = read(fd, data, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+#ifdef __linux__
+ssize_t kernel_copy(int method, int in, int out, size_t len) {
+  switch (method) {
+    case 0:
+      return (ssize_t)copy_file_range(in, nullptr, out, nullptr, len, 0);
+    case 1:
+      return sendfile(out, in, nullptr, len);
+    default:
+      return splice(in, nullptr, out, nullptr, len, SPLICE_F_MOVE);
+  }
+}
+#endif
+
+// moves exactly len bytes from in to out at their current offsets. the
+// kernel paths are tried first: copy_file_range between regular files,
+// sendfile from a regular file, splice from a pipe. whichever one the pair
+// of descriptors does not support is skipped, read and write are the
+// fallback
+bool copy_fd(int in, int out, uint64_t len) {
+#ifdef __linux__
+  for (int method = 0; method < 3 && len > 0; ++method) {
+    while (len > 0) {
+      size_t chunk = (size_t)std::min<uint64_t>(len, 1 << 30);
+      ssize_t n = kernel_copy(method, in, out, chunk);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && (errno == EINVAL || errno == ENOSYS || errno == EXDEV ||
+                    errno == EBADF || errno == EOPNOTSUPP))
+        break;
+      if (n <= 0) return false;
+      len -= (uint64_t)n;
+    }
+  }
+#endif
+  char buf[65536];
+  while (len > 0) {
+    size_t chunk = (size_t)std::min<uint64_t>(len, sizeof(buf));
+    if (!read_all(in, buf, chunk) || !write_all(out, buf, chunk)) return false;
+    len -= chunk;
+  }
+  return true;
+}
+
+bool collect(const Root& root, std::vector<Entry>& entries) {
+  // the roots themselves are followed, dotfile managers often link them
+  auto add = [&](const fs::path& source, const std::string& path) {
+    struct stat st;
+    bool is_root = path == root.name;
+    int rc = is_root ? stat(source.c_str(), &st) : lstat(source.c_str(), &st);
+    if (rc != 0) return false;
+    Entry e;
+    e.path = path;
+    e.source = source;
+    e.mode = st.st_mode & 07777;
+    if (S_ISDIR(st.st_mode)) {
+      e.kind = kDirectory;
+    } else if (S_ISLNK(st.st_mode)) {
+      e.kind = kSymlink;
+      std::error_code ec;
+      e.target = fs::read_symlink(source, ec).string();
+      if (ec) return false;
+    } else if (S_ISREG(st.st_mode)) {
+      e.kind = kFile;
+      e.size = (uint64_t)st.st_size;
+      e.hash = cjsh_store::hash_file(source);
+      if (e.hash.empty()) return false;
+    } else {
+      return true;  // sockets and fifos are not configuration
+    }
+    entries.push_back(std::move(e));
+    return true;
+  };
+
+  std::error_code ec;
+  if (!fs::exists(fs::symlink_status(root.path, ec))) return true;
+  if (!add(root.path, root.name)) return false;
+  if (entries.back().kind != kDirectory) return true;
+  std::vector<fs::path> children;
+  for (auto it = fs::recursive_directory_iterator(root.path, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    children.push_back(it->path());
+  if (ec) return false;
+  // sorted so the same tree always gives the same bundle
+  std::sort(children.begin(), children.end());
+  for (auto& child : children) {
+    std::string rel = child.lexically_relative(root.path).generic_string();
+    if (!add(child, std::string(root.name) + "/" + rel)) return false;
+  }
+  return true;
+}
+
+std::string encode_manifest(const std::vector<Entry>& entries) {
+  std::string manifest;
+  for (auto& e : entries) {
+    manifest += (char)e.kind;
+    put_u32(manifest, e.mode);
+    put_u64(manifest, e.size);
+    put_str(manifest, e.hash);
+    put_str(manifest, e.path);
+    put_str(manifest, e.target);
+  }
+  return manifest;
+}
+
+// relative, no "..", and under a bundled root
+bool safe_path(const std::string& path) {
+  fs::path p(path);
+  if (p.is_absolute() || p.empty()) return false;
+  for (auto& part : p)
+    if (part == ".." || part == ".") return false;
+  for (auto& root : roots()) {
+    std::string name = root.name;
+    if (path == name || path.rfind(name + "/", 0) == 0) return true;
+  }
+  return false;
+}
+
+bool decode_manifest(const std::string& manifest, uint32_t count,
+                     std::vector<Entry>& entries) {
+  Reader in(manifest.data(), manifest.size());
+  std::vector<std::string> links;
+  for (uint32_t i = 0; i < count; ++i) {
+    Entry e;
+    uint8_t kind;
+    if (!in.u8(kind) || kind > kSymlink || !in.u32(e.mode) ||
+        !in.u64(e.size) || !in.str(e.hash) || !in.str(e.path) ||
+        !in.str(e.target))
+      return false;
+    e.kind = (Kind)kind;
+    if (!safe_path(e.path)) return false;
+    // nothing may be written through a bundled symlink
+    for (auto& link : links)
+      if (e.path.rfind(link + "/", 0) == 0) return false;
+    if (e.kind == kSymlink) links.push_back(e.path);
+    if (e.kind == kFile && e.hash.size() != kHashSize) return false;
+    entries.push_back(std::move(e));
+  }
+  return in.done();
+}
+
+// staging lives next to the target so the final rename stays on one
+// filesystem
+fs::path staging_dir(const std::string& path) {
+  fs::path base = path.rfind("home/", 0) == 0
+                      ? cjsh_filesystem::g_user_home_path
+                      : cjsh_filesystem::g_cjsh_data_path;
+  return base / (".cjsh-import." + std::to_string(getpid()));
+}
+
+fs::path staged_path(const std::string& path) {
+  return staging_dir(path) / path.substr(5);
+}
+
+bool stage(int fd, const Entry& e) {
+  fs::path dest = staged_path(e.path);
+  std::error_code ec;
+  fs::create_directories(dest.parent_path(), ec);
+  switch (e.kind) {
+    case kDirectory:
+      // modes are set once everything is staged, a read only directory
+      // would refuse its own entries
+      fs::create_directories(dest, ec);
+      return !ec;
+    case kSymlink:
+      fs::create_symlink(e.target, dest, ec);
+      return !ec;
+    case kFile: {
+      int out = open(dest.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                     e.mode & 0777);
+      if (out < 0) return false;
+      bool ok = copy_fd(fd, out, e.size) && fchmod(out, e.mode & 07777) == 0 &&
+                fsync(out) == 0;
+      close(out);
+      return ok && cjsh_store::hash_file(dest) == e.hash;
+    }
+  }
+  return false;
+}
+
+void remove_staging() {
+  std::error_code ec;
+  fs::remove_all(staging_dir("home/"), ec);
+  fs::remove_all(staging_dir("data/"), ec);
+}
+
+// swaps every bundled root into place, keeping the old ones aside until all
+// renames have gone through so a failure can be undone
+bool swap_roots(const std::vector<Entry>& entries) {
+  struct Swap {
+    fs::path dest;
+    fs::path backup;
+    bool had_old;
+  };
+  std::vector<Swap> done;
+  bool ok = true;
+  for (auto& root : roots()) {
+    bool bundled = false;
+    for (auto& e : entries) bundled = bundled || e.path == root.name;
+    if (!bundled) continue;
+    Swap s{root.path, root.path, false};
+    s.backup += ".cjsh-old";
+    std::error_code ec;
+    fs::remove_all(s.backup, ec);
+    if (fs::exists(fs::symlink_status(s.dest, ec))) {
+      fs::rename(s.dest, s.backup, ec);
+      if (ec) {
+        ok = false;
+        break;
+      }
+      s.had_old = true;
+    }
+    fs::rename(staged_path(root.name), s.dest, ec);
+    if (ec) {
+      if (s.had_old) fs::rename(s.backup, s.dest, ec);
+      ok = false;
+      break;
+    }
+    done.push_back(s);
+  }
+  for (auto it = done.rbegin(); it != done.rend(); ++it) {
+    std::error_code ec;
+    if (!ok) {
+      fs::remove_all(it->dest, ec);
+      if (it->had_old) fs::rename(it->backup, it->dest, ec);
+    } else if (it->had_old) {
+      fs::remove_all(it->backup, ec);
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
+// layout: magic, u32 version, u32 entry count, u64 manifest size, the
+// manifest, the hex sha256 of everything before it, then the contents of
+// every file entry in manifest order
+bool export_bundle(int fd) {
+  std::vector<Entry> entries;
+  for (auto& root : roots()) {
+    if (!collect(root, entries)) {
+      fail("cannot read " + root.path.string());
+      return false;
+    }
+  }
+  // files are opened before anything is written so a missing one does not
+  // leave half a bundle behind
+  std::vector<int> fds;
+  auto close_all = [&]() {
+    for (int f : fds) close(f);
+  };
+  for (auto& e : entries) {
+    if (e.kind != kFile) continue;
+    int in = open(e.source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+      close_all();
+      fail("cannot open " + e.source.string());
+      return false;
+    }
+    fds.push_back(in);
+  }
+
+  std::string manifest = encode_manifest(entries);
+  std::string head(kMagic, sizeof(kMagic));
+  put_u32(head, kVersion);
+  put_u32(head, (uint32_t)entries.size());
+  put_u64(head, manifest.size());
+  head += manifest;
+  head += cjsh_store::hash_bytes(head.data(), head.size());
+  bool ok = write_all(fd, head.data(), head.size());
+  size_t next = 0;
+  for (auto& e : entries) {
+    if (!ok) break;
+    if (e.kind != kFile) continue;
+    // a file that shrank since it was hashed fails here, one that changed
+    // in place fails the hash check on import
+    ok = copy_fd(fds[next++], fd, e.size);
+    if (!ok) fail("short read from " + e.source.string());
+  }
+  close_all();
+  if (!ok) fail("write failed");
+  return ok;
+}
+
+bool import_bundle(int fd) {
+  char head[kHeaderSize];
+  if (!read_all(fd, head, sizeof(head)) ||
+      std::memcmp(head, kMagic, sizeof(kMagic)) != 0) {
+    fail("not a cjsh bundle");
+    return false;
+  }
+  Reader fields(head + sizeof(kMagic), sizeof(head) - sizeof(kMagic));
+  uint32_t version, count;
+  uint64_t manifest_size;
+  fields.u32(version);
+  fields.u32(count);
+  fields.u64(manifest_size);
+  if (version != kVersion) {
+    fail("unsupported bundle version " + std::to_string(version));
+    return false;
+  }
+  if (manifest_size > kMaxManifest) {
+    fail("corrupt manifest");
+    return false;
+  }
+  std::string checked(head, sizeof(head));
+  checked.resize(sizeof(head) + manifest_size);
+  std::string checksum(kHashSize, '\0');
+  if (!read_all(fd, &checked[sizeof(head)], manifest_size) ||
+      !read_all(fd, &checksum[0], kHashSize) ||
+      cjsh_store::hash_bytes(checked.data(), checked.size()) != checksum) {
+    fail("manifest checksum mismatch");
+    return false;
+  }
+  std::vector<Entry> entries;
+  if (!decode_manifest(checked.substr(sizeof(head)), count, entries)) {
+    fail("corrupt manifest");
+    return false;
+  }
+
+  remove_staging();
+  for (auto& e : entries) {
+    if (!stage(fd, e)) {
+      remove_staging();
+      fail("verification failed for " + e.path);
+      return false;
+    }
+  }
+  for (auto& e : entries)
+    if (e.kind == kDirectory) chmod(staged_path(e.path).c_str(), e.mode);
+  bool ok = swap_roots(entries);
+  remove_staging();
+  if (!ok) fail("could not replace the current setup, nothing was changed");
+  return ok;
+}
+
+}  // namespace cjsh_bundle
@@ -1,5 +1,7 @@
 #include "cjsh_filesystem.h"
 
+#include <sys/stat.h>
+
 #include <chrono>
 #include <cstdlib>
 #include <fstream>
@@ -8,6 +10,22 @@
 
 namespace cjsh_filesystem {
 
+bool file_stamp(const fs::path& path, FileStamp& stamp) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return false;
+#ifdef __APPLE__
+  const struct timespec& mtime = st.st_mtimespec;
+#else
+  const struct timespec& mtime = st.st_mtim;
+#endif
+  stamp.device = (uint64_t)st.st_dev;
+  stamp.inode = (uint64_t)st.st_ino;
+  stamp.mtime = (int64_t)mtime.tv_sec * 1000000000 + mtime.tv_nsec;
+  stamp.size = (uint64_t)st.st_size;
+  stamp.directory = S_ISDIR(st.st_mode);
+  return true;
+}
+
 bool should_refresh_executable_cache() {
   namespace fs = cjsh_filesystem::fs;
   try {
@@ -20,30 +38,164 @@ bool should_refresh_executable_cache() {
   }
 }
 
+namespace {
+
+// identity of a PATH directory; its mtime changes whenever an entry is
+// added, removed or renamed, so a matching key means the listing is current
+struct DirKey {
+  std::string file;   // cache file name, device and inode
+  std::string mtime;  // nanoseconds
+};
+
+bool dir_key(const fs::path& dir, DirKey& key) {
+  FileStamp stamp;
+  if (!file_stamp(dir, stamp) || !stamp.directory) return false;
+  std::ostringstream file;
+  file << std::hex << (unsigned long long)stamp.device << "-"
+       << (unsigned long long)stamp.inode;
+  key.file = file.str();
+  key.mtime = std::to_string((long long)stamp.mtime);
+  return true;
+}
+
+// first line is the directory, second the mtime it was scanned at. shared
+// entries must be owned by root or by us so other users cannot inject names
+bool read_dir_cache(const fs::path& cache_file, const fs::path& dir,
+                    const DirKey& key, bool shared,
+                    std::vector<std::string>& names) {
+  struct stat st;
+  if (stat(cache_file.c_str(), &st) != 0) return false;
+  if (shared && st.st_uid != 0 && st.st_uid != getuid()) return false;
+  std::ifstream ifs(cache_file);
+  std::string cached_dir, cached_mtime;
+  if (!std::getline(ifs, cached_dir) || cached_dir != dir.string())
+    return false;
+  if (!std::getline(ifs, cached_mtime) || cached_mtime != key.mtime)
+    return false;
+  std::string line;
+  while (std::getline(ifs, line)) names.push_back(line);
+  return true;
+}
+
+bool write_dir_cache(const fs::path& cache_dir, const fs::path& dir,
+                     const DirKey& key,
+                     const std::vector<std::string>& names) {
+  std::error_code ec;
+  fs::create_directories(cache_dir, ec);
+  fs::path tmp = cache_dir / (key.file + ".tmp." + std::to_string(getpid()));
+  {
+    std::ofstream ofs(tmp);
+    if (!ofs.is_open()) return false;
+    ofs << dir.string() << "\n" << key.mtime << "\n";
+    for (auto& n : names) ofs << n << "\n";
+    if (!ofs) return false;
+  }
+  fs::permissions(tmp,
+                  fs::perms::owner_read | fs::perms::owner_write |
+                      fs::perms::group_read | fs::perms::others_read,
+                  ec);
+  fs::rename(tmp, cache_dir / key.file, ec);
+  if (ec) fs::remove(tmp, ec);
+  return !ec;
+}
+
+std::vector<std::string> scan_dir(const fs::path& dir) {
+  std::vector<std::string> names;
+  try {
+    for (auto& entry : fs::directory_iterator(
+             dir, fs::directory_options::skip_permission_denied)) {
+      auto perms = fs::status(entry.path()).permissions();
+      if (fs::is_regular_file(entry.path()) &&
+          (perms & fs::perms::owner_exec) != fs::perms::none) {
+        names.push_back(entry.path().filename().string());
+      }
+    }
+  } catch (const fs::filesystem_error& e) {
+  }
+  return names;
+}
+
+// only root's listings are shared, and only of directories every user can
+// list anyway: root owned and readable by all, under root owned parents
+// everyone can enter. readers ignore shared entries anyone else wrote, and
+// a private directory's names must not end up in a world readable file
+bool shareable(const fs::path& dir) {
+  if (geteuid() != 0) return false;
+  std::error_code ec;
+  fs::path real = fs::canonical(dir, ec);
+  if (ec) return false;
+  struct stat st;
+  if (stat(real.c_str(), &st) != 0 || !(st.st_mode & S_IROTH)) return false;
+  for (fs::path p = real;; p = p.parent_path()) {
+    if (stat(p.c_str(), &st) != 0 || st.st_uid != 0 ||
+        !(st.st_mode & S_IXOTH))
+      return false;
+    if (p == p.root_path()) return true;
+  }
+}
+
+// the system cache first, then the user's overlay, and a scan only when
+// neither is current
+std::vector<std::string> list_dir(const fs::path& dir, const DirKey& key) {
+  std::vector<std::string> names;
+  if (read_dir_cache(g_cjsh_system_executable_dirs_path / key.file, dir, key,
+                     true, names) ||
+      read_dir_cache(g_cjsh_executable_dirs_path / key.file, dir, key, false,
+                     names))
+    return names;
+  names = scan_dir(dir);
+  if (!shareable(dir) ||
+      !write_dir_cache(g_cjsh_system_executable_dirs_path, dir, key, names))
+    write_dir_cache(g_cjsh_executable_dirs_path, dir, key, names);
+  return names;
+}
+
+}  // namespace
+
 bool build_executable_cache() {
   const char* path_env = std::getenv("PATH");
   if (!path_env) return false;
   std::stringstream ss(path_env);
   std::string dir;
-  std::vector<fs::path> executables;
+  std::vector<std::string> executables;
   while (std::getline(ss, dir, ':')) {
     fs::path p(dir);
-    if (!fs::is_directory(p)) continue;
-    try {
-      for (auto& entry : fs::directory_iterator(
-               p, fs::directory_options::skip_permission_denied)) {
-        auto perms = fs::status(entry.path()).permissions();
-        if (fs::is_regular_file(entry.path()) &&
-            (perms & fs::perms::owner_exec) != fs::perms::none) {
-          executables.push_back(entry.path());
-        }
-      }
-    } catch (const fs::filesystem_error& e) {
-    }
+    DirKey key;
+    if (dir.empty() || !dir_key(p, key)) continue;
+    std::vector<std::string> names = list_dir(p, key);
+    executables.insert(executables.end(), names.begin(), names.end());
   }
   std::ofstream ofs(g_cjsh_found_executables_path);
   if (!ofs.is_open()) return false;
-  for (auto& e : executables) ofs << e.filename().string() << "\n";
+  for (auto& e : executables) ofs << e << "\n";
+  return true;
+}
+
+bool initialize_system_cache() {
+  for (const fs::path& dir :
+       {g_cjsh_system_executable_dirs_path, g_cjsh_system_store_path}) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+      std::cerr << "Cannot create " << dir.string() << ": " << ec.message()
+                << std::endl;
+      return false;
+    }
+    if (chmod(dir.c_str(), 0755) != 0) {
+      std::cerr << "Cannot set permissions on " << dir.string() << std::endl;
+      return false;
+    }
+  }
+  // symlinked ones like /bin -> usr/bin share their target's entry
+  for (const char* dir : {"/usr/local/sbin", "/usr/local/bin", "/usr/sbin",
+                          "/usr/bin", "/sbin", "/bin"}) {
+    std::error_code ec;
+    DirKey key;
+    if (fs::is_symlink(dir, ec) || !dir_key(dir, key) || !shareable(dir))
+      continue;
+    write_dir_cache(g_cjsh_system_executable_dirs_path, dir, key,
+                    scan_dir(dir));
+  }
   return true;
 }
 
@@ -0,0 +1,239 @@
+#include "../include/cjsh_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "../include/cjsh_filesystem.h"
+
+namespace cjsh_snapshot {
+
+namespace {
+
+constexpr uint64_t kFnvOffset = 1469598103934665603ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t fnv1a(uint64_t hash, const char* data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+uint64_t hash_file(uint64_t hash, const fs::path& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  char buf[8192];
+  while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0)
+    hash = fnv1a(hash, buf, static_cast<size_t>(ifs.gcount()));
+  // keep "a" + "bc" apart from "ab" + "c"
+  return fnv1a(hash, "\0", 1);
+}
+
+std::string unquote(const std::string& s) {
+  if (s.size() >= 2 && (s.front() == '\'' || s.front() == '"') &&
+      s.back() == s.front())
+    return s.substr(1, s.size() - 2);
+  return s;
+}
+
+class Builder {
+ public:
+  void add(Section section, const std::string& key,
+           const std::string& value = "") {
+    entries_[section].push_back({intern(key), intern(value)});
+  }
+
+  bool write(const fs::path& out, uint64_t hash) const {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.section_count = kSectionCount;
+    header.source_hash = hash;
+    uint64_t offset = sizeof(Header);
+    for (uint32_t s = 0; s < kSectionCount; ++s) {
+      header.sections[s].offset = offset;
+      header.sections[s].count = static_cast<uint32_t>(entries_[s].size());
+      offset += entries_[s].size() * sizeof(Entry);
+    }
+    header.strings_offset = offset;
+    header.strings_size = strings_.size();
+
+    fs::path tmp = out;
+    tmp += ".tmp";
+    {
+      std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+      if (!ofs.is_open()) return false;
+      ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      for (auto& section : entries_)
+        ofs.write(reinterpret_cast<const char*>(section.data()),
+                  section.size() * sizeof(Entry));
+      ofs.write(strings_.data(), strings_.size());
+      if (!ofs) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, out, ec);
+    return !ec;
+  }
+
+ private:
+  StrRef intern(const std::string& s) {
+    StrRef ref{static_cast<uint32_t>(strings_.size()),
+               static_cast<uint32_t>(s.size())};
+    strings_ += s;
+    return ref;
+  }
+
+  std::vector<Entry> entries_[kSectionCount];
+  std::string strings_;
+};
+
+void parse_line(Builder& builder, const std::string& line, bool profile) {
+  if (line.empty() || line[0] == '#') return;
+  if (line.rfind("alias ", 0) == 0 || line.rfind("export ", 0) == 0) {
+    bool alias = line[0] == 'a';
+    std::string body = line.substr(alias ? 6 : 7);
+    size_t eq = body.find('=');
+    if (eq != std::string::npos) {
+      Section section = alias ? (profile ? kProfileAliases : kAliases)
+                              : (profile ? kProfileExports : kExports);
+      builder.add(section, body.substr(0, eq), unquote(body.substr(eq + 1)));
+      return;
+    }
+  }
+  if (!profile && line.rfind("theme load ", 0) == 0) {
+    builder.add(kTheme, line.substr(11));
+    return;
+  }
+  if (!profile && line.rfind("plugin ", 0) == 0) {
+    const std::string suffix = " enable";
+    if (line.size() > 7 + suffix.size() &&
+        line.compare(line.size() - suffix.size(), suffix.size(), suffix) ==
+            0) {
+      builder.add(kPlugins, line.substr(7, line.size() - 7 - suffix.size()));
+      return;
+    }
+  }
+  if (profile && line.rfind("-", 0) == 0) {
+    builder.add(kStartupArgs, line);
+    return;
+  }
+  builder.add(profile ? kProfileCommands : kStartupCommands, line);
+}
+
+}  // namespace
+
+uint64_t source_hash(const fs::path& profile, const fs::path& rc) {
+  return hash_file(hash_file(kFnvOffset, profile), rc);
+}
+
+bool compile(const fs::path& profile, const fs::path& rc,
+             const fs::path& out) {
+  Builder builder;
+  // hash before parsing, a concurrent edit then only makes the result stale
+  uint64_t hash = source_hash(profile, rc);
+  for (bool is_profile : {true, false}) {
+    std::ifstream ifs(is_profile ? profile : rc);
+    std::string line;
+    while (std::getline(ifs, line)) parse_line(builder, line, is_profile);
+  }
+  return builder.write(out, hash);
+}
+
+bool compile() {
+  return compile(cjsh_filesystem::g_cjsh_profile_path,
+                 cjsh_filesystem::g_cjsh_source_path,
+                 cjsh_filesystem::g_cjsh_snapshot_path);
+}
+
+Snapshot::~Snapshot() { close(); }
+
+bool Snapshot::open(const fs::path& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) return false;
+  data_ = static_cast<const char*>(map);
+  size_ = static_cast<size_t>(st.st_size);
+
+  auto* header = reinterpret_cast<const Header*>(data_);
+  bool valid = std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+               header->version == kVersion &&
+               header->section_count == kSectionCount &&
+               header->strings_offset <= size_ &&
+               header->strings_size <= size_ - header->strings_offset;
+  for (uint32_t s = 0; valid && s < kSectionCount; ++s) {
+    const SectionRef& ref = header->sections[s];
+    valid = ref.offset % alignof(Entry) == 0 && ref.offset <= size_ &&
+            ref.count <= (size_ - ref.offset) / sizeof(Entry);
+    for (uint32_t i = 0; valid && i < ref.count; ++i) {
+      const Entry& e = entries(static_cast<Section>(s))[i];
+      for (const StrRef& r : {e.key, e.value})
+        valid = valid && (uint64_t)r.offset + r.length <= header->strings_size;
+    }
+  }
+  if (!valid) close();
+  return valid;
+}
+
+void Snapshot::close() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+uint64_t Snapshot::source_hash() const {
+  return data_ ? reinterpret_cast<const Header*>(data_)->source_hash : 0;
+}
+
+size_t Snapshot::count(Section section) const {
+  if (!data_ || section >= kSectionCount) return 0;
+  return reinterpret_cast<const Header*>(data_)->sections[section].count;
+}
+
+std::string_view Snapshot::key(Section section, size_t i) const {
+  return i < count(section) ? str(entries(section)[i].key) : "";
+}
+
+std::string_view Snapshot::value(Section section, size_t i) const {
+  return i < count(section) ? str(entries(section)[i].value) : "";
+}
+
+std::string_view Snapshot::str(const StrRef& ref) const {
+  auto* header = reinterpret_cast<const Header*>(data_);
+  return std::string_view(data_ + header->strings_offset + ref.offset,
+                          ref.length);
+}
+
+const Entry* Snapshot::entries(Section section) const {
+  auto* header = reinterpret_cast<const Header*>(data_);
+  return reinterpret_cast<const Entry*>(data_ +
+                                        header->sections[section].offset);
+}
+
+bool is_stale(const fs::path& snapshot, const fs::path& profile,
+              const fs::path& rc) {
+  Snapshot snap;
+  if (!snap.open(snapshot)) return true;
+  return snap.source_hash() != source_hash(profile, rc);
+}
+
+bool is_stale() {
+  return is_stale(cjsh_filesystem::g_cjsh_snapshot_path,
+                  cjsh_filesystem::g_cjsh_profile_path,
+                  cjsh_filesystem::g_cjsh_source_path);
+}
+
+}  // namespace cjsh_snapshot
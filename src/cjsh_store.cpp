@@ -0,0 +1,325 @@
+#include "../include/cjsh_store.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../include/cjsh_filesystem.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace cjsh_store {
+
+namespace {
+
+class Sha256 {
+ public:
+  void update(const unsigned char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      block_[block_len_++] = data[i];
+      if (block_len_ == 64) {
+        transform();
+        block_len_ = 0;
+      }
+    }
+    bit_len_ += (uint64_t)len * 8;
+  }
+
+  std::string hex() {
+    uint64_t bits = bit_len_;
+    unsigned char pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (block_len_ != 56) update(&pad, 1);
+    unsigned char len[8];
+    for (int i = 0; i < 8; ++i) len[i] = (unsigned char)(bits >> (56 - 8 * i));
+    update(len, 8);
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (uint32_t h : state_)
+      for (int shift = 28; shift >= 0; shift -= 4)
+        out += digits[(h >> shift) & 0xf];
+    return out;
+  }
+
+ private:
+  static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+  void transform() {
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+        0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+        0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+      w[i] = (uint32_t)block_[i * 4] << 24 | (uint32_t)block_[i * 4 + 1] << 16 |
+             (uint32_t)block_[i * 4 + 2] << 8 | block_[i * 4 + 3];
+    for (int i = 16; i < 64; ++i) {
+      uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3],
+             e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+      uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                    ((e & f) ^ (~e & g)) + k[i] + w[i];
+      uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                    ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+  }
+
+  uint32_t state_[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  unsigned char block_[64];
+  size_t block_len_ = 0;
+  uint64_t bit_len_ = 0;
+};
+
+// objects live in <store>/<first two hex digits>/<rest>
+fs::path object_in(const fs::path& store, const std::string& hash) {
+  return store / hash.substr(0, 2) / hash.substr(2);
+}
+
+// only objects owned by root or by us are used: the shared store is
+// writable by everyone, so anyone else could have put any file under a hash
+bool trusted(const fs::path& object, uid_t& owner) {
+  struct stat st;
+  if (lstat(object.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+  owner = st.st_uid;
+  return st.st_uid == 0 || st.st_uid == getuid();
+}
+
+// the shared store wins so objects are only kept once per host
+fs::path find_object(const std::string& hash) {
+  for (const fs::path& store : {cjsh_filesystem::g_cjsh_system_store_path,
+                                cjsh_filesystem::g_cjsh_store_path}) {
+    fs::path object = object_in(store, hash);
+    uid_t owner;
+    if (trusted(object, owner)) return object;
+  }
+  return {};
+}
+
+fs::path add_object(const fs::path& source, const std::string& hash) {
+  fs::path existing = find_object(hash);
+  if (!existing.empty()) return existing;
+  std::error_code ec;
+  for (const fs::path& store : {cjsh_filesystem::g_cjsh_system_store_path,
+                                cjsh_filesystem::g_cjsh_store_path}) {
+    // other users only trust root's objects in the shared store, anyone
+    // else's would never be reused there, so they stay in our own store
+    bool shared = store == cjsh_filesystem::g_cjsh_system_store_path;
+    if (shared && (geteuid() != 0 || access(store.c_str(), W_OK) != 0))
+      continue;
+    fs::path object = object_in(store, hash);
+    fs::create_directories(object.parent_path(), ec);
+    fs::path tmp = object;
+    tmp += ".tmp." + std::to_string(getpid());
+    if (!fs::copy_file(source, tmp, fs::copy_options::overwrite_existing, ec))
+      continue;
+    // objects are shared by every link, nobody may write through one
+    fs::permissions(tmp,
+                    fs::perms::owner_read | fs::perms::group_read |
+                        fs::perms::others_read,
+                    ec);
+    fs::rename(tmp, object, ec);
+    if (!ec) return object;
+    fs::remove(tmp, ec);
+  }
+  return {};
+}
+
+bool reflink(const fs::path& from, const fs::path& to) {
+#if defined(__linux__) && defined(FICLONE)
+  int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) return false;
+  int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = out >= 0 && ioctl(out, FICLONE, in) == 0;
+  if (out >= 0) close(out);
+  close(in);
+  if (!ok) unlink(to.c_str());
+  return ok;
+#else
+  (void)from;
+  (void)to;
+  return false;
+#endif
+}
+
+// hardlink when the object is ours, else reflink (other owners, other
+// filesystems), else copy. the owner of a hardlinked object could make it
+// writable again and change it under everyone who links it
+bool link_object(const fs::path& object, const fs::path& dest) {
+  std::error_code ec;
+  fs::path tmp = dest;
+  tmp += ".tmp";
+  fs::remove(tmp, ec);
+  uid_t owner;
+  if (!trusted(object, owner)) return false;
+  if (owner == getuid())
+    fs::create_hard_link(object, tmp, ec);
+  else
+    ec = std::make_error_code(std::errc::permission_denied);
+  if (ec && !reflink(object, tmp)) {
+    ec.clear();
+    fs::copy_file(object, tmp, ec);
+    if (ec) return false;
+  }
+  fs::rename(tmp, dest, ec);
+  if (ec) fs::remove(tmp, ec);
+  return !ec;
+}
+
+// dest -> hash, the last line for a dest wins
+std::map<std::string, std::string> read_refs() {
+  std::map<std::string, std::string> refs;
+  std::ifstream ifs(cjsh_filesystem::g_cjsh_store_refs_path);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    size_t tab = line.find('\t');
+    if (tab != std::string::npos)
+      refs[line.substr(tab + 1)] = line.substr(0, tab);
+  }
+  return refs;
+}
+
+void add_ref(const std::string& hash, const fs::path& dest) {
+  std::ofstream ofs(cjsh_filesystem::g_cjsh_store_refs_path, std::ios::app);
+  ofs << hash << "\t" << fs::absolute(dest).string() << "\n";
+}
+
+}  // namespace
+
+std::string hash_file(const fs::path& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs.is_open()) return "";
+  Sha256 sha;
+  char buf[65536];
+  while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0)
+    sha.update(reinterpret_cast<unsigned char*>(buf),
+               static_cast<size_t>(ifs.gcount()));
+  return sha.hex();
+}
+
+std::string hash_bytes(const void* data, size_t len) {
+  Sha256 sha;
+  sha.update(static_cast<const unsigned char*>(data), len);
+  return sha.hex();
+}
+
+bool install(const fs::path& source, const fs::path& dest) {
+  std::string hash = hash_file(source);
+  if (hash.empty()) return false;
+  fs::path object = add_object(source, hash);
+  if (object.empty() || !link_object(object, dest)) return false;
+  add_ref(hash, dest);
+  return true;
+}
+
+bool restore(const fs::path& dest) {
+  auto refs = read_refs();
+  auto it = refs.find(fs::absolute(dest).string());
+  if (it == refs.end()) return false;
+  fs::path object = find_object(it->second);
+  if (object.empty() || !link_object(object, dest)) return false;
+  add_ref(it->second, dest);
+  return true;
+}
+
+bool uninstall(const fs::path& dest) {
+  std::error_code ec;
+  return fs::remove(dest, ec);
+}
+
+GcStats collect_garbage() {
+  GcStats stats;
+  // a ref is live while something is still installed at its path
+  std::set<std::string> live;
+  std::vector<std::pair<std::string, std::string>> kept;
+  for (auto& [dest, hash] : read_refs()) {
+    if (!fs::exists(dest)) continue;
+    live.insert(hash);
+    kept.emplace_back(hash, dest);
+  }
+  {
+    fs::path tmp = cjsh_filesystem::g_cjsh_store_refs_path;
+    tmp += ".tmp";
+    std::ofstream ofs(tmp);
+    for (auto& [hash, dest] : kept) ofs << hash << "\t" << dest << "\n";
+    ofs.close();
+    std::error_code ec;
+    fs::rename(tmp, cjsh_filesystem::g_cjsh_store_refs_path, ec);
+  }
+
+  // our own store, and our objects in the shared store. shared objects of
+  // others are theirs to collect. other users only ever copy or reflink a
+  // root object, so once it is gone their restore() downloads it again
+  auto now = fs::file_time_type::clock::now();
+  for (const fs::path& store : {cjsh_filesystem::g_cjsh_store_path,
+                                cjsh_filesystem::g_cjsh_system_store_path}) {
+    bool shared = store == cjsh_filesystem::g_cjsh_system_store_path;
+    std::error_code ec;
+    if (!fs::is_directory(store, ec)) continue;
+    for (auto& entry : fs::recursive_directory_iterator(
+             store, fs::directory_options::skip_permission_denied, ec)) {
+      if (!entry.is_regular_file(ec)) continue;
+      std::string name = entry.path().filename().string();
+      size_t tmp = name.find(".tmp.");
+      if (tmp != std::string::npos) {
+        // another cjsh may still be writing it, only leftovers of a crash go
+        if (now - entry.last_write_time(ec) < std::chrono::hours(1) || ec)
+          continue;
+      } else {
+        std::string hash =
+            entry.path().parent_path().filename().string() + name;
+        if (live.count(hash)) continue;
+      }
+      struct stat st;
+      if (lstat(entry.path().c_str(), &st) != 0 || st.st_nlink > 1 ||
+          (shared && st.st_uid != getuid()))
+        continue;
+      if (fs::remove(entry.path(), ec)) {
+        stats.objects_removed++;
+        stats.bytes_freed += static_cast<uintmax_t>(st.st_size);
+      }
+    }
+  }
+  return stats;
+}
+
+}  // namespace cjsh_store
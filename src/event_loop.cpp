@@ -0,0 +1,294 @@
+#include "../include/event_loop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ncurses.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace tui {
+
+namespace fs = std::filesystem;
+
+EventLoop& EventLoop::instance() {
+  static EventLoop loop;
+  return loop;
+}
+
+EventLoop::EventLoop() {
+  if (pipe(wake_pipe_) == 0) {
+    for (int fd : wake_pipe_) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  }
+#ifdef __linux__
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+EventLoop::~EventLoop() {
+  // normally a no-op, Configurator::run already shut the loop down
+  shutdown();
+  for (int fd : wake_pipe_)
+    if (fd >= 0) close(fd);
+  if (inotify_fd_ >= 0) close(inotify_fd_);
+}
+
+void EventLoop::run(const DrawHandler& draw, const KeyHandler& on_key) {
+  bool done = false;
+  dirty_ = true;
+  while (!done && !quit_) {
+    if (dirty_) {
+      dirty_ = false;
+      draw();
+      refresh();
+    }
+    dispatch_once(on_key, done);
+  }
+  // whatever screen we return to was drawn over
+  quit_ = false;
+  dirty_ = true;
+}
+
+void EventLoop::request_redraw() { dirty_ = true; }
+
+void EventLoop::quit() { quit_ = true; }
+
+int EventLoop::add_timer(std::chrono::milliseconds delay, Callback cb,
+                         bool repeat) {
+  int id = next_id_++;
+  timers_.push_back({id, std::chrono::steady_clock::now() + delay, delay,
+                     repeat, std::move(cb)});
+  return id;
+}
+
+void EventLoop::cancel_timer(int id) {
+  timers_.erase(std::remove_if(timers_.begin(), timers_.end(),
+                               [id](const Timer& t) { return t.id == id; }),
+                timers_.end());
+}
+
+int EventLoop::add_watch(const fs::path& path, Callback cb) {
+  Watch w;
+  w.id = next_id_++;
+  w.wd = -1;
+  w.path = path;
+  w.cb = std::move(cb);
+  std::error_code ec;
+  bool is_dir = fs::is_directory(path, ec);
+  fs::path dir = is_dir ? path : path.parent_path();
+  if (!is_dir) w.name = path.filename().string();
+  w.mtime = fs::last_write_time(path, ec);
+#ifdef __linux__
+  if (inotify_fd_ >= 0) {
+    // watch the directory so editors that replace the file by rename are seen
+    w.wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                 IN_CREATE | IN_DELETE);
+  }
+#endif
+  if (w.wd < 0 && mtime_timer_ == 0) {
+    mtime_timer_ = add_timer(
+        std::chrono::seconds(1), [this]() { check_watches_by_mtime(); }, true);
+  }
+  watches_.push_back(std::move(w));
+  return watches_.back().id;
+}
+
+void EventLoop::remove_watch(int id) {
+  auto it = std::find_if(watches_.begin(), watches_.end(),
+                         [id](const Watch& w) { return w.id == id; });
+  if (it == watches_.end()) return;
+  int wd = it->wd;
+  watches_.erase(it);
+#ifdef __linux__
+  if (wd >= 0 && std::none_of(watches_.begin(), watches_.end(),
+                              [wd](const Watch& w) { return w.wd == wd; }))
+    inotify_rm_watch(inotify_fd_, wd);
+#endif
+  (void)wd;
+}
+
+void EventLoop::post(Callback cb) {
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    if (stopping_) return;
+    posted_.push_back(std::move(cb));
+  }
+  if (wake_pipe_[1] >= 0) {
+    char b = 1;
+    ssize_t r = write(wake_pipe_[1], &b, 1);
+    (void)r;  // a full pipe already guarantees a wakeup
+  }
+}
+
+void EventLoop::dispatch_once(const KeyHandler& on_key, bool& done) {
+  // ncurses may already hold buffered input that poll() cannot see
+  if (drain_keys(on_key, done)) return;
+
+  pollfd fds[3];
+  nfds_t count = 0;
+  fds[count++] = {STDIN_FILENO, POLLIN, 0};
+  fds[count++] = {wake_pipe_[0], POLLIN, 0};
+  if (inotify_fd_ >= 0) fds[count++] = {inotify_fd_, POLLIN, 0};
+
+  int n = poll(fds, count, next_timeout_ms());
+  if (n < 0) {
+    // EINTR is usually SIGWINCH, getch() reports it as KEY_RESIZE
+    if (errno != EINTR) dirty_ = true;
+    return;
+  }
+  if (fds[1].revents & POLLIN) {
+    char buf[64];
+    while (read(wake_pipe_[0], buf, sizeof(buf)) > 0) {
+    }
+    drain_posted();
+  }
+  if (count > 2 && (fds[2].revents & POLLIN)) handle_inotify();
+  fire_timers();
+}
+
+bool EventLoop::drain_keys(const KeyHandler& on_key, bool& done) {
+  bool any = false;
+  nodelay(stdscr, TRUE);
+  int c;
+  while (!done && !quit_ && (c = getch()) != ERR) {
+    any = true;
+    dirty_ = true;
+    // handlers may open blocking prompts, give them normal input mode
+    nodelay(stdscr, FALSE);
+    if (!on_key(c)) done = true;
+    nodelay(stdscr, TRUE);
+  }
+  nodelay(stdscr, FALSE);
+  return any;
+}
+
+int EventLoop::next_timeout_ms() const {
+  if (timers_.empty()) return -1;
+  auto now = std::chrono::steady_clock::now();
+  auto next = timers_.front().deadline;
+  for (auto& t : timers_) next = std::min(next, t.deadline);
+  if (next <= now) return 0;
+  auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+  return static_cast<int>(ms) + 1;
+}
+
+void EventLoop::fire_timers() {
+  auto now = std::chrono::steady_clock::now();
+  std::vector<Callback> due;
+  for (auto it = timers_.begin(); it != timers_.end();) {
+    if (it->deadline > now) {
+      ++it;
+      continue;
+    }
+    due.push_back(it->cb);
+    if (it->repeat) {
+      it->deadline = now + it->interval;
+      ++it;
+    } else {
+      it = timers_.erase(it);
+    }
+  }
+  // callbacks may add or cancel timers
+  for (auto& cb : due) cb();
+}
+
+void EventLoop::handle_inotify() {
+#ifdef __linux__
+  alignas(inotify_event) char buf[4096];
+  std::vector<int> fired;
+  ssize_t len;
+  while ((len = read(inotify_fd_, buf, sizeof(buf))) > 0) {
+    for (char* p = buf; p < buf + len;) {
+      auto* ev = reinterpret_cast<inotify_event*>(p);
+      std::string name = ev->len ? ev->name : "";
+      for (auto& w : watches_) {
+        if (w.wd != ev->wd) continue;
+        if (!w.name.empty() && w.name != name) continue;
+        if (std::find(fired.begin(), fired.end(), w.id) == fired.end())
+          fired.push_back(w.id);
+      }
+      p += sizeof(inotify_event) + ev->len;
+    }
+  }
+  // a callback may remove watches, look each one up again before calling it
+  for (int id : fired) {
+    auto it = std::find_if(watches_.begin(), watches_.end(),
+                           [id](const Watch& w) { return w.id == id; });
+    if (it != watches_.end()) {
+      Callback cb = it->cb;
+      cb();
+    }
+  }
+#endif
+}
+
+void EventLoop::check_watches_by_mtime() {
+  std::vector<Callback> changed;
+  for (auto& w : watches_) {
+    if (w.wd >= 0) continue;
+    std::error_code ec;
+    auto mtime = fs::last_write_time(w.path, ec);
+    if (mtime != w.mtime) {
+      w.mtime = mtime;
+      changed.push_back(w.cb);
+    }
+  }
+  for (auto& cb : changed) cb();
+}
+
+void EventLoop::spawn(Callback work) {
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    if (stopping_) return;
+  }
+  reap_workers();
+  auto finished = std::make_shared<std::atomic<bool>>(false);
+  workers_.push_back({std::thread([work = std::move(work), finished]() {
+                        work();
+                        *finished = true;
+                      }),
+                      finished});
+}
+
+void EventLoop::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    stopping_ = true;
+    posted_.clear();
+  }
+  for (auto& w : workers_) w.thread.join();
+  workers_.clear();
+}
+
+// joins the workers that are done so the list does not grow
+void EventLoop::reap_workers() {
+  for (auto it = workers_.begin(); it != workers_.end();) {
+    if (*it->finished) {
+      it->thread.join();
+      it = workers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void EventLoop::drain_posted() {
+  std::vector<Callback> posted;
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    posted.swap(posted_);
+  }
+  for (auto& cb : posted) cb();
+}
+
+}  // namespace tui
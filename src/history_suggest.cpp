@@ -0,0 +1,211 @@
+#include "../include/history_suggest.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace history_suggest {
+
+namespace {
+
+// Misra-Gries summary: at most capacity counters, every key seen more than
+// total / (capacity + 1) times is kept and counts are never overestimated.
+// keys point into the mapped history, so they cost no allocation
+class HeavyHitters {
+ public:
+  explicit HeavyHitters(size_t capacity) : capacity_(capacity) {
+    counts_.reserve(capacity + 1);
+  }
+
+  void add(std::string_view key, uint64_t n = 1) {
+    auto it = counts_.find(key);
+    if (it != counts_.end()) {
+      it->second += n;
+      return;
+    }
+    if (counts_.size() < capacity_) {
+      counts_.emplace(key, n);
+      return;
+    }
+    // every decrement round removes at least one counter and is paid for by
+    // the occurrences it cancels, so this stays linear overall
+    uint64_t dec = n;
+    for (auto& kv : counts_) dec = std::min(dec, kv.second);
+    for (auto i = counts_.begin(); i != counts_.end();) {
+      i->second -= dec;
+      if (i->second == 0)
+        i = counts_.erase(i);
+      else
+        ++i;
+    }
+    if (n > dec) counts_.emplace(key, n - dec);
+  }
+
+  void merge(const HeavyHitters& other) {
+    for (auto& kv : other.counts_) add(kv.first, kv.second);
+  }
+
+  const std::unordered_map<std::string_view, uint64_t>& counts() const {
+    return counts_;
+  }
+
+ private:
+  size_t capacity_;
+  std::unordered_map<std::string_view, uint64_t> counts_;
+};
+
+struct ChunkResult {
+  explicit ChunkResult(size_t capacity)
+      : commands(capacity), prefixes(capacity) {}
+  HeavyHitters commands;
+  HeavyHitters prefixes;
+};
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && std::isspace((unsigned char)s.front()))
+    s.remove_prefix(1);
+  while (!s.empty() && std::isspace((unsigned char)s.back()))
+    s.remove_suffix(1);
+  return s;
+}
+
+// the first two words when the line has more than two
+std::string_view leading_words(std::string_view line) {
+  size_t first = line.find(' ');
+  if (first == std::string_view::npos) return {};
+  size_t second = line.find(' ', line.find_first_not_of(' ', first));
+  if (second == std::string_view::npos) return {};
+  return line.substr(0, second);
+}
+
+void count_chunk(std::string_view text, const Options& options,
+                 ChunkResult& result) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if (end == std::string_view::npos) end = text.size();
+    std::string_view line = trim(text.substr(pos, end - pos));
+    pos = end + 1;
+    if (line.empty() || line.front() == '#') continue;
+    if (line.size() >= options.min_command_length) result.commands.add(line);
+    std::string_view prefix = leading_words(line);
+    if (prefix.size() >= options.min_prefix_length) result.prefixes.add(prefix);
+  }
+}
+
+// initials of the words, "docker compose up" -> "dcu", made unique
+std::string alias_for(const std::string& command,
+                      std::set<std::string>& taken) {
+  std::string base;
+  bool word_start = true;
+  for (char c : command) {
+    if (c == ' ') {
+      word_start = true;
+    } else if (word_start) {
+      if (std::isalnum((unsigned char)c))
+        base += (char)std::tolower((unsigned char)c);
+      word_start = false;
+    }
+  }
+  if (base.size() < 2) base += "a";
+  std::string name = base;
+  for (int n = 2; taken.count(name); ++n) name = base + std::to_string(n);
+  taken.insert(name);
+  return name;
+}
+
+}  // namespace
+
+std::vector<Suggestion> suggest(const fs::path& history, const Options& options,
+                                const std::set<std::string>& taken_names,
+                                const std::set<std::string>& aliased_commands) {
+  std::vector<Suggestion> suggestions;
+  int fd = open(history.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return suggestions;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return suggestions;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return suggestions;
+  madvise(map, size, MADV_SEQUENTIAL);
+  std::string_view text(static_cast<const char*>(map), size);
+
+  // chunks end on line boundaries so no line is split between workers
+  unsigned threads = options.threads ? options.threads
+                                     : std::thread::hardware_concurrency();
+  threads = (unsigned)std::min<size_t>(std::max(1u, threads),
+                                       size / (1 << 20) + 1);
+  std::vector<std::string_view> chunks;
+  for (size_t t = 1, start = 0; t <= threads && start < size; ++t) {
+    size_t end = t == threads ? size : std::max(start, size * t / threads);
+    if (end < size) {
+      size_t nl = text.find('\n', end);
+      end = nl == std::string_view::npos ? size : nl + 1;
+    }
+    chunks.push_back(text.substr(start, end - start));
+    start = end;
+  }
+  std::vector<ChunkResult> results(chunks.size(),
+                                   ChunkResult(options.capacity));
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < chunks.size(); ++i)
+    pool.emplace_back(
+        [&, i]() { count_chunk(chunks[i], options, results[i]); });
+  count_chunk(chunks[0], options, results[0]);
+  for (auto& t : pool) t.join();
+  for (size_t i = 1; i < results.size(); ++i) {
+    results[0].commands.merge(results[i].commands);
+    results[0].prefixes.merge(results[i].prefixes);
+  }
+
+  // rank by characters saved
+  struct Candidate {
+    std::string_view command;
+    uint64_t count;
+    bool prefix;
+  };
+  std::vector<Candidate> candidates;
+  for (bool prefix : {false, true}) {
+    auto& summary = prefix ? results[0].prefixes : results[0].commands;
+    for (auto& [command, count] : summary.counts()) {
+      if (count < options.min_count ||
+          command.find('\'') != std::string_view::npos ||
+          aliased_commands.count(std::string(command)))
+        continue;
+      candidates.push_back({command, count, prefix});
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) {
+              uint64_t sa = a.count * a.command.size();
+              uint64_t sb = b.count * b.command.size();
+              return sa != sb ? sa > sb : a.command < b.command;
+            });
+  if (candidates.size() > options.max_results)
+    candidates.resize(options.max_results);
+
+  std::set<std::string> taken = taken_names;
+  for (auto& c : candidates) {
+    Suggestion s;
+    s.command = std::string(c.command);
+    s.alias = alias_for(s.command, taken);
+    s.count = c.count;
+    s.prefix = c.prefix;
+    suggestions.push_back(std::move(s));
+  }
+  munmap(map, size);
+  return suggestions;
+}
+
+}  // namespace history_suggest
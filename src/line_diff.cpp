@@ -0,0 +1,364 @@
+#include "../include/line_diff.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace line_diff {
+
+namespace {
+
+// marks removed and added lines for a and b, which hold interned line ids.
+// the V arrays are reused by every recursion level so memory stays O(N + M)
+class Myers {
+ public:
+  Myers(const std::vector<int>& a, const std::vector<int>& b)
+      : removed(a.size(), false), added(b.size(), false), a_(a), b_(b) {
+    size_t size = 2 * (a.size() + b.size()) + 3;
+    vf_.resize(size);
+    vb_.resize(size);
+    // past this many edits the search gives up on an optimal split. the
+    // fallbacks below cost about cost_limit_ * (N + M) in total, so big
+    // inputs get a lower limit to keep that within kWork steps
+    constexpr long kWork = 1L << 22;
+    const long total = (long)(a.size() + b.size());
+    cost_limit_ = std::max<long>(256, 4 * (long)std::sqrt((double)total));
+    if (total > 0)
+      cost_limit_ = std::max(32L, std::min(cost_limit_, kWork / total));
+    find_unique_matches();
+    compare(0, (long)a.size(), 0, (long)b.size());
+  }
+
+  std::vector<bool> removed;
+  std::vector<bool> added;
+
+ private:
+  void compare(long a_lo, long a_hi, long b_lo, long b_hi) {
+    // besides the common prefix and suffix, trim lines whose only match is
+    // outside this region. they are changes whatever the rest looks like
+    for (bool trimmed = true; trimmed;) {
+      trimmed = false;
+      while (a_lo < a_hi && b_lo < b_hi && a_[a_lo] == b_[b_lo]) {
+        ++a_lo;
+        ++b_lo;
+      }
+      while (a_lo < a_hi && b_lo < b_hi && a_[a_hi - 1] == b_[b_hi - 1]) {
+        --a_hi;
+        --b_hi;
+      }
+      while (a_lo < a_hi && elsewhere(a_match_[a_lo], b_lo, b_hi)) {
+        removed[a_lo++] = true;
+        trimmed = true;
+      }
+      while (a_lo < a_hi && elsewhere(a_match_[a_hi - 1], b_lo, b_hi)) {
+        removed[--a_hi] = true;
+        trimmed = true;
+      }
+      while (b_lo < b_hi && elsewhere(b_match_[b_lo], a_lo, a_hi)) {
+        added[b_lo++] = true;
+        trimmed = true;
+      }
+      while (b_lo < b_hi && elsewhere(b_match_[b_hi - 1], a_lo, a_hi)) {
+        added[--b_hi] = true;
+        trimmed = true;
+      }
+    }
+    if (a_lo == a_hi) {
+      for (long j = b_lo; j < b_hi; ++j) added[j] = true;
+      return;
+    }
+    if (b_lo == b_hi) {
+      for (long i = a_lo; i < a_hi; ++i) removed[i] = true;
+      return;
+    }
+    long x, y;
+    if (!split(a_lo, a_hi, b_lo, b_hi, x, y) &&
+        compare_anchored(a_lo, a_hi, b_lo, b_hi))
+      return;
+    compare(a_lo, a_lo + x, b_lo, b_lo + y);
+    compare(a_lo + x, a_hi, b_lo + y, b_hi);
+  }
+
+  // a_match_[i] is the position in b of a[i] when that line occurs exactly
+  // once on each side, otherwise -1. b_match_ is the same from b to a
+  void find_unique_matches() {
+    int ids = 0;
+    for (int id : a_) ids = std::max(ids, id + 1);
+    for (int id : b_) ids = std::max(ids, id + 1);
+    std::vector<int> in_a(ids, 0), in_b(ids, 0);
+    std::vector<long> at_a(ids, -1), at_b(ids, -1);
+    for (size_t i = 0; i < a_.size(); ++i) {
+      ++in_a[a_[i]];
+      at_a[a_[i]] = (long)i;
+    }
+    for (size_t j = 0; j < b_.size(); ++j) {
+      ++in_b[b_[j]];
+      at_b[b_[j]] = (long)j;
+    }
+    a_match_.assign(a_.size(), -1);
+    b_match_.assign(b_.size(), -1);
+    for (size_t i = 0; i < a_.size(); ++i)
+      if (in_a[a_[i]] == 1 && in_b[a_[i]] == 1) a_match_[i] = at_b[a_[i]];
+    for (size_t j = 0; j < b_.size(); ++j)
+      if (in_a[b_[j]] == 1 && in_b[b_[j]] == 1) b_match_[j] = at_a[b_[j]];
+  }
+
+  static bool elsewhere(long match, long lo, long hi) {
+    return match >= 0 && (match < lo || match >= hi);
+  }
+
+  // patience diff for when Myers gives up: keeps the longest run of lines
+  // unique on both sides that appear in the same order, and compares the
+  // gaps between them. the gaps have no such lines left, so this happens at
+  // most once per region. false if the region has none
+  bool compare_anchored(long a_lo, long a_hi, long b_lo, long b_hi) {
+    std::vector<long> anchors;  // positions in a
+    for (long i = a_lo; i < a_hi; ++i)
+      if (a_match_[i] >= b_lo && a_match_[i] < b_hi)
+        anchors.push_back(i);
+    if (anchors.empty()) return false;
+    // longest increasing subsequence of the b positions. tails[l] is the
+    // anchor ending the best run of length l + 1 found so far
+    std::vector<long> tails, prev(anchors.size(), -1);
+    for (size_t k = 0; k < anchors.size(); ++k) {
+      long j = a_match_[anchors[k]];
+      auto it = std::lower_bound(
+          tails.begin(), tails.end(), j,
+          [&](long t, long v) { return a_match_[anchors[t]] < v; });
+      if (it != tails.begin()) prev[k] = *(it - 1);
+      if (it == tails.end())
+        tails.push_back((long)k);
+      else
+        *it = (long)k;
+    }
+    std::vector<long> run;
+    for (long k = tails.back(); k >= 0; k = prev[k]) run.push_back(anchors[k]);
+    std::reverse(run.begin(), run.end());
+    for (long i : run) {
+      long j = a_match_[i];
+      compare(a_lo, i, b_lo, j);
+      a_lo = i + 1;
+      b_lo = j + 1;
+    }
+    compare(a_lo, a_hi, b_lo, b_hi);
+    return true;
+  }
+
+  // finds a point (x, y), relative to a_lo and b_lo, on an optimal edit path
+  // that leaves both halves strictly smaller: the start of the middle snake.
+  // false when that costs more than cost_limit_ edits, with (x, y) then on
+  // the middle anti-diagonal instead
+  bool split(long a_lo, long a_hi, long b_lo, long b_hi, long& x_out,
+             long& y_out) {
+    const long n = a_hi - a_lo;
+    const long m = b_hi - b_lo;
+    const long delta = n - m;
+    const bool odd = delta & 1;
+    const long max = (n + m + 1) / 2;
+    const long off = max + 1;
+    const int* a = a_.data() + a_lo;
+    const int* b = b_.data() + b_lo;
+    long* vf = vf_.data();
+    long* vb = vb_.data();
+    vf[off + 1] = 0;
+    vb[off + 1] = 0;
+    for (long d = 0; d <= max; ++d) {
+      for (long k = -d; k <= d; k += 2) {
+        long x = (k == -d || (k != d && vf[off + k - 1] < vf[off + k + 1]))
+                     ? vf[off + k + 1]
+                     : vf[off + k - 1] + 1;
+        long start = x;
+        long y = x - k;
+        while (x < n && y < m && a[x] == b[y]) {
+          ++x;
+          ++y;
+        }
+        vf[off + k] = x;
+        long kr = delta - k;
+        if (odd && kr >= -(d - 1) && kr <= d - 1 && x + vb[off + kr] >= n) {
+          x_out = start;
+          y_out = start - k;
+          return true;
+        }
+      }
+      for (long k = -d; k <= d; k += 2) {
+        long x = (k == -d || (k != d && vb[off + k - 1] < vb[off + k + 1]))
+                     ? vb[off + k + 1]
+                     : vb[off + k - 1] + 1;
+        long start = x;
+        long y = x - k;
+        while (x < n && y < m && a[n - 1 - x] == b[m - 1 - y]) {
+          ++x;
+          ++y;
+        }
+        vb[off + k] = x;
+        long kf = delta - k;
+        if (!odd && kf >= -d && kf <= d && x + vf[off + kf] >= n) {
+          x_out = n - start;
+          y_out = m - (start - k);
+          return true;
+        }
+      }
+      if (d >= cost_limit_) {
+        // cut on the middle anti-diagonal, along the diagonal of the
+        // furthest forward path so far. both halves are about half the
+        // size, so the recursion stays O(log(N + M)) deep
+        long best = -1, best_k = 0;
+        for (long k = -d; k <= d; k += 2) {
+          long x = vf[off + k];
+          long y = x - k;
+          if (x > n || y < 0 || y > m) continue;
+          if (x + y > best) {
+            best = x + y;
+            best_k = k;
+          }
+        }
+        const long half = (n + m) / 2;
+        long x = (half + best_k) / 2;
+        x = std::max(x, std::max(0L, half - m));
+        x = std::min(x, std::min(n, half));
+        x_out = x;
+        y_out = half - x;
+        return false;
+      }
+    }
+    // unreachable for non empty inputs, fall back to a trivial split
+    x_out = n;
+    y_out = 0;
+    return true;
+  }
+
+  const std::vector<int>& a_;
+  const std::vector<int>& b_;
+  std::vector<long> vf_;
+  std::vector<long> vb_;
+  std::vector<long> a_match_;
+  std::vector<long> b_match_;
+  long cost_limit_;
+};
+
+}  // namespace
+
+std::string Hunk::header() const {
+  return "@@ -" + std::to_string(old_count ? old_start + 1 : old_start) + "," +
+         std::to_string(old_count) + " +" +
+         std::to_string(new_count ? new_start + 1 : new_start) + "," +
+         std::to_string(new_count) + " @@";
+}
+
+std::vector<Hunk> diff(const std::vector<std::string>& old_lines,
+                       const std::vector<std::string>& new_lines,
+                       size_t context) {
+  // compare small ints instead of strings
+  std::unordered_map<std::string_view, int> ids;
+  ids.reserve(old_lines.size() + new_lines.size());
+  std::vector<int> a, b;
+  a.reserve(old_lines.size());
+  b.reserve(new_lines.size());
+  for (auto& l : old_lines)
+    a.push_back(ids.emplace(l, (int)ids.size()).first->second);
+  for (auto& l : new_lines)
+    b.push_back(ids.emplace(l, (int)ids.size()).first->second);
+
+  // a line missing from the other side is always a change, so only lines
+  // that appear on both sides go through Myers. this keeps rewritten blocks
+  // from inflating the edit distance it has to search
+  std::vector<uint8_t> seen(ids.size(), 0);
+  for (int id : a) seen[id] |= 1;
+  for (int id : b) seen[id] |= 2;
+  std::vector<int> fa, fb;
+  std::vector<size_t> a_index, b_index;
+  for (size_t i = 0; i < a.size(); ++i)
+    if (seen[a[i]] == 3) {
+      fa.push_back(a[i]);
+      a_index.push_back(i);
+    }
+  for (size_t j = 0; j < b.size(); ++j)
+    if (seen[b[j]] == 3) {
+      fb.push_back(b[j]);
+      b_index.push_back(j);
+    }
+  Myers myers(fa, fb);
+  std::vector<bool> removed(a.size(), true), added(b.size(), true);
+  for (size_t i = 0; i < fa.size(); ++i)
+    removed[a_index[i]] = myers.removed[i];
+  for (size_t j = 0; j < fb.size(); ++j) added[b_index[j]] = myers.added[j];
+
+  // change regions as [old_begin, old_end) x [new_begin, new_end)
+  struct Change {
+    size_t ob, oe, nb, ne;
+  };
+  std::vector<Change> changes;
+  size_t i = 0, j = 0;
+  while (i < a.size() || j < b.size()) {
+    if (i < a.size() && j < b.size() && !removed[i] && !added[j]) {
+      ++i;
+      ++j;
+      continue;
+    }
+    Change c{i, i, j, j};
+    while (c.oe < a.size() && removed[c.oe]) ++c.oe;
+    while (c.ne < b.size() && added[c.ne]) ++c.ne;
+    changes.push_back(c);
+    i = c.oe;
+    j = c.ne;
+  }
+
+  std::vector<Hunk> hunks;
+  for (size_t c = 0; c < changes.size();) {
+    // merge changes whose context would touch
+    size_t last = c;
+    while (last + 1 < changes.size() &&
+           changes[last + 1].ob - changes[last].oe <= 2 * context)
+      ++last;
+    Hunk h;
+    size_t lead = std::min(context, changes[c].ob);
+    h.old_start = changes[c].ob - lead;
+    h.new_start = changes[c].nb - lead;
+    size_t old_pos = h.old_start;
+    for (size_t k = c; k <= last; ++k) {
+      for (; old_pos < changes[k].ob; ++old_pos)
+        h.lines.push_back(" " + old_lines[old_pos]);
+      for (size_t o = changes[k].ob; o < changes[k].oe; ++o)
+        h.lines.push_back("-" + old_lines[o]);
+      for (size_t n = changes[k].nb; n < changes[k].ne; ++n)
+        h.lines.push_back("+" + new_lines[n]);
+      old_pos = changes[k].oe;
+    }
+    size_t trail = std::min(context, old_lines.size() - old_pos);
+    for (size_t t = 0; t < trail; ++t)
+      h.lines.push_back(" " + old_lines[old_pos + t]);
+    h.old_count = old_pos + trail - h.old_start;
+    h.new_count = changes[last].ne + trail - h.new_start;
+    hunks.push_back(std::move(h));
+    c = last + 1;
+  }
+  return hunks;
+}
+
+std::vector<std::string> apply(const std::vector<std::string>& old_lines,
+                               const std::vector<std::string>& new_lines,
+                               const std::vector<Hunk>& hunks,
+                               const std::vector<bool>& accepted) {
+  std::vector<std::string> out;
+  size_t old_pos = 0;
+  for (size_t h = 0; h < hunks.size(); ++h) {
+    const Hunk& hunk = hunks[h];
+    out.insert(out.end(), old_lines.begin() + old_pos,
+               old_lines.begin() + hunk.old_start);
+    if (h < accepted.size() && accepted[h]) {
+      out.insert(out.end(), new_lines.begin() + hunk.new_start,
+                 new_lines.begin() + hunk.new_start + hunk.new_count);
+    } else {
+      out.insert(out.end(), old_lines.begin() + hunk.old_start,
+                 old_lines.begin() + hunk.old_start + hunk.old_count);
+    }
+    old_pos = hunk.old_start + hunk.old_count;
+  }
+  out.insert(out.end(), old_lines.begin() + old_pos, old_lines.end());
+  return out;
+}
+
+}  // namespace line_diff
@@ -0,0 +1,79 @@
+#include "../include/list_filter.h"
+
+#include <cctype>
+
+namespace list_filter {
+
+namespace {
+
+// lowercase, with tabs as spaces so words split the same way in both
+char normalize(char c) {
+  if (c == '\t') return ' ';
+  return (char)std::tolower((unsigned char)c);
+}
+
+std::vector<std::string_view> words(std::string_view query) {
+  std::vector<std::string_view> out;
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t start = query.find_first_not_of(' ', pos);
+    if (start == std::string_view::npos) break;
+    size_t end = query.find(' ', start);
+    if (end == std::string_view::npos) end = query.size();
+    out.push_back(query.substr(start, end - start));
+    pos = end;
+  }
+  return out;
+}
+
+}  // namespace
+
+Filter::Filter(const std::vector<std::string>& items) {
+  size_t total = 0;
+  for (auto& item : items) total += item.size();
+  text_.reserve(total);
+  offsets_.reserve(items.size() + 1);
+  matches_.reserve(items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    offsets_.push_back(text_.size());
+    for (char c : items[i]) text_ += normalize(c);
+    matches_.push_back(i);
+  }
+  offsets_.push_back(text_.size());
+}
+
+const std::vector<size_t>& Filter::update(const std::string& query) {
+  std::string normalized;
+  normalized.reserve(query.size());
+  for (char c : query) normalized += normalize(c);
+  if (normalized == query_) return matches_;
+
+  // appending to the query can only lengthen its last word or add words,
+  // so every new match is among the old ones
+  bool narrower = normalized.compare(0, query_.size(), query_) == 0;
+  std::vector<size_t> candidates;
+  if (!narrower) {
+    candidates.resize(size());
+    for (size_t i = 0; i < candidates.size(); ++i) candidates[i] = i;
+  } else {
+    candidates.swap(matches_);
+  }
+  query_ = std::move(normalized);
+
+  std::vector<std::string_view> terms = words(query_);
+  matches_.clear();
+  for (size_t i : candidates) {
+    std::string_view haystack = item(i);
+    bool all = true;
+    for (auto term : terms) {
+      if (haystack.find(term) == std::string_view::npos) {
+        all = false;
+        break;
+      }
+    }
+    if (all) matches_.push_back(i);
+  }
+  return matches_;
+}
+
+}  // namespace list_filter
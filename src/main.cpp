@@ -1,11 +1,76 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <string>
 
+#include "../include/cjsh_bundle.h"
 #include "../include/cjsh_filesystem.h"
+#include "../include/cjsh_snapshot.h"
 #include "../include/tui_configurator.h"
 
+// cjsh-configure export [file] / import [file], "-" or no file for
+// stdout / stdin
+static int run_bundle_command(const std::string& command,
+                              const std::string& file) {
+  bool to_std = file.empty() || file == "-";
+  if (command == "export") {
+    if (to_std && isatty(STDOUT_FILENO)) {
+      std::cerr << "Refusing to write a bundle to a terminal." << std::endl;
+      return 1;
+    }
+    if (to_std) return cjsh_bundle::export_bundle(STDOUT_FILENO) ? 0 : 1;
+    // written aside and renamed so a failed export never replaces a good one
+    std::string tmp = file + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      std::cerr << "Cannot write " << tmp << ": " << std::strerror(errno)
+                << std::endl;
+      return 1;
+    }
+    bool ok = cjsh_bundle::export_bundle(fd) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(tmp.c_str(), file.c_str()) == 0) return 0;
+    unlink(tmp.c_str());
+    return 1;
+  }
+  int fd = to_std ? STDIN_FILENO : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "Cannot read " << file << ": " << std::strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  bool ok = cjsh_bundle::import_bundle(fd);
+  if (!to_std) close(fd);
+  if (!ok) return 1;
+  cjsh_snapshot::compile();
+  std::cerr << "Imported. If you are currently using cjsh, please restart it "
+               "to apply the changes."
+            << std::endl;
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
   initialize_cjsh_directories();
+  if (argc > 1) {
+    std::string command = argv[1];
+    if ((command == "export" || command == "import") && argc <= 3)
+      return run_bundle_command(command, argc == 3 ? argv[2] : "");
+    if (command == "init-system-cache" && argc == 2)
+      return cjsh_filesystem::initialize_system_cache() ? 0 : 1;
+    std::cerr << "usage: " << argv[0]
+              << " [export|import [file] | init-system-cache]" << std::endl;
+    return 1;
+  }
+  // alias suggestions check names against it, and a rebuild mostly reads
+  // the per directory caches
+  if (cjsh_filesystem::should_refresh_executable_cache())
+    cjsh_filesystem::build_executable_cache();
   tui::Configurator::run();
+  // also picks up edits made outside the configurator
+  if (cjsh_snapshot::is_stale()) cjsh_snapshot::compile();
   std::cout << "If you are currently using cjsh, please restart it to apply "
                "the changes."
             << std::endl;
@@ -0,0 +1,462 @@
+#include "../include/plugin_inspector.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <elf.h>
+#endif
+
+#include "../include/cache_io.h"
+#include "../include/cjsh_filesystem.h"
+
+namespace plugin_inspector {
+
+const std::vector<std::string> required_entry_points = {
+    "plugin_get_info", "plugin_initialize", "plugin_shutdown",
+    "plugin_handle_command"};
+
+namespace {
+
+#if defined(__x86_64__)
+const std::string host_arch = "x86_64";
+#elif defined(__aarch64__)
+const std::string host_arch = "aarch64";
+#elif defined(__i386__)
+const std::string host_arch = "i386";
+#elif defined(__arm__)
+const std::string host_arch = "arm";
+#elif defined(__riscv)
+const std::string host_arch = "riscv";
+#elif defined(__powerpc64__)
+const std::string host_arch = "ppc64";
+#else
+const std::string host_arch = "unknown";
+#endif
+
+// read only mapping of a whole file
+class MappedFile {
+ public:
+  explicit MappedFile(const fs::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED) {
+        data_ = static_cast<const unsigned char*>(map);
+        size_ = static_cast<size_t>(st.st_size);
+      }
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data_) munmap(const_cast<unsigned char*>(data_), size_);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool in_bounds(uint64_t offset, uint64_t len) const {
+    return offset <= size_ && len <= size_ - offset;
+  }
+
+ private:
+  const unsigned char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+std::vector<std::string> split_paths(const std::string& list, char sep) {
+  std::vector<std::string> out;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, sep))
+    if (!item.empty()) out.push_back(item);
+  return out;
+}
+
+// directories the dynamic loader searches after RUNPATH and LD_LIBRARY_PATH
+const std::vector<std::string>& system_library_dirs() {
+  static const std::vector<std::string> dirs = []() {
+    std::vector<std::string> d;
+    std::error_code ec;
+    for (auto& entry : fs::directory_iterator("/etc/ld.so.conf.d", ec)) {
+      std::ifstream ifs(entry.path());
+      std::string line;
+      while (std::getline(ifs, line))
+        if (!line.empty() && line[0] == '/') d.push_back(line);
+    }
+    for (const char* dir :
+         {"/lib", "/usr/lib", "/lib64", "/usr/lib64", "/usr/local/lib"}) {
+      d.push_back(dir);
+      d.push_back(std::string(dir) + "/" + host_arch + "-linux-gnu");
+    }
+    return d;
+  }();
+  return dirs;
+}
+
+bool find_library(const std::string& name,
+                  const std::vector<std::string>& runpaths,
+                  const fs::path& origin) {
+  std::error_code ec;
+  if (name.find('/') != std::string::npos) return fs::exists(name, ec);
+  std::vector<std::string> dirs;
+  for (std::string dir : runpaths) {
+    for (const std::string token : {"${ORIGIN}", "$ORIGIN"}) {
+      size_t pos;
+      while ((pos = dir.find(token)) != std::string::npos)
+        dir.replace(pos, token.size(), origin.string());
+    }
+    dirs.push_back(dir);
+  }
+  if (const char* env = std::getenv("LD_LIBRARY_PATH"))
+    for (auto& dir : split_paths(env, ':')) dirs.push_back(dir);
+  for (auto& dir : system_library_dirs()) dirs.push_back(dir);
+  for (auto& dir : dirs)
+    if (fs::exists(fs::path(dir) / name, ec)) return true;
+  return false;
+}
+
+void resolve_deps(PluginInfo& info) {
+  info.missing_deps.clear();
+  for (auto& lib : info.needed)
+    if (!find_library(lib, info.runpaths, info.path.parent_path()))
+      info.missing_deps.push_back(lib);
+}
+
+#ifdef __linux__
+std::string machine_name(uint16_t machine) {
+  switch (machine) {
+    case EM_X86_64:
+      return "x86_64";
+    case EM_AARCH64:
+      return "aarch64";
+    case EM_386:
+      return "i386";
+    case EM_ARM:
+      return "arm";
+    case EM_RISCV:
+      return "riscv";
+    case EM_PPC64:
+      return "ppc64";
+    default:
+      return "machine " + std::to_string(machine);
+  }
+}
+
+// C string at offset inside a string table section, empty if out of bounds
+std::string table_string(const MappedFile& file, uint64_t table_offset,
+                         uint64_t table_size, uint64_t index) {
+  if (index >= table_size || !file.in_bounds(table_offset, table_size))
+    return "";
+  const char* start =
+      reinterpret_cast<const char*>(file.data() + table_offset + index);
+  size_t max = static_cast<size_t>(table_size - index);
+  return std::string(start, strnlen(start, max));
+}
+
+template <typename Ehdr, typename Shdr, typename Sym, typename Dyn>
+void parse_elf(const MappedFile& file, PluginInfo& info) {
+  if (!file.in_bounds(0, sizeof(Ehdr))) {
+    info.error = "truncated ELF header";
+    return;
+  }
+  auto* eh = reinterpret_cast<const Ehdr*>(file.data());
+  info.arch = machine_name(eh->e_machine);
+  info.arch_matches_host = info.arch == host_arch;
+  if (eh->e_shentsize != sizeof(Shdr) || eh->e_shoff % alignof(Shdr) != 0 ||
+      !file.in_bounds(eh->e_shoff, (uint64_t)eh->e_shnum * sizeof(Shdr))) {
+    info.error = "bad section header table";
+    return;
+  }
+  auto* sections = reinterpret_cast<const Shdr*>(file.data() + eh->e_shoff);
+  for (uint16_t i = 0; i < eh->e_shnum; ++i) {
+    const Shdr& sh = sections[i];
+    if ((sh.sh_type != SHT_DYNSYM && sh.sh_type != SHT_DYNAMIC) ||
+        sh.sh_link >= eh->e_shnum || !file.in_bounds(sh.sh_offset, sh.sh_size))
+      continue;
+    const Shdr& strtab = sections[sh.sh_link];
+    if (sh.sh_type == SHT_DYNSYM) {
+      if (sh.sh_offset % alignof(Sym) != 0) continue;
+      auto* syms = reinterpret_cast<const Sym*>(file.data() + sh.sh_offset);
+      for (size_t s = 0; s < sh.sh_size / sizeof(Sym); ++s) {
+        unsigned bind = syms[s].st_info >> 4;
+        if (syms[s].st_shndx == SHN_UNDEF ||
+            (bind != STB_GLOBAL && bind != STB_WEAK))
+          continue;
+        std::string name = table_string(file, strtab.sh_offset,
+                                        strtab.sh_size, syms[s].st_name);
+        if (name.rfind("plugin_", 0) == 0) info.entry_points.push_back(name);
+      }
+    } else {
+      if (sh.sh_offset % alignof(Dyn) != 0) continue;
+      auto* dyn = reinterpret_cast<const Dyn*>(file.data() + sh.sh_offset);
+      for (size_t d = 0; d < sh.sh_size / sizeof(Dyn); ++d) {
+        if (dyn[d].d_tag == DT_NULL) break;
+        if (dyn[d].d_tag != DT_NEEDED && dyn[d].d_tag != DT_RUNPATH &&
+            dyn[d].d_tag != DT_RPATH)
+          continue;
+        std::string value = table_string(file, strtab.sh_offset,
+                                         strtab.sh_size, dyn[d].d_un.d_val);
+        if (dyn[d].d_tag == DT_NEEDED) {
+          info.needed.push_back(value);
+        } else {
+          for (auto& dir : split_paths(value, ':'))
+            info.runpaths.push_back(dir);
+        }
+      }
+    }
+  }
+  std::sort(info.entry_points.begin(), info.entry_points.end());
+  for (auto& sym : required_entry_points)
+    if (!std::binary_search(info.entry_points.begin(), info.entry_points.end(),
+                            sym))
+      info.missing_entry_points.push_back(sym);
+  resolve_deps(info);
+}
+#endif
+
+// only the architecture is read from Mach-O files
+void parse_macho(const MappedFile& file, PluginInfo& info) {
+  info.format = "Mach-O";
+  if (!file.in_bounds(0, 8)) {
+    info.error = "truncated Mach-O header";
+    return;
+  }
+  uint32_t cputype;
+  std::memcpy(&cputype, file.data() + 4, sizeof(cputype));
+  if (cputype == 0x01000007)
+    info.arch = "x86_64";
+  else if (cputype == 0x0100000c)
+    info.arch = "aarch64";
+  else
+    info.arch = "cpu " + std::to_string(cputype);
+  info.arch_matches_host = info.arch == host_arch;
+}
+
+constexpr char kMagic[8] = {'C', 'J', 'P', 'L', 'U', 'G', 'N', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct CacheEntry {
+  cjsh_filesystem::FileStamp stamp;
+  PluginInfo info;
+};
+
+bool same_file(const cjsh_filesystem::FileStamp& a,
+               const cjsh_filesystem::FileStamp& b) {
+  return a.device == b.device && a.inode == b.inode && a.mtime == b.mtime &&
+         a.size == b.size;
+}
+
+// loaded from g_cjsh_plugin_cache_path on first use, guarded by cache_mutex
+std::mutex cache_mutex;
+bool cache_loaded = false;
+std::map<fs::path, CacheEntry> cache;
+
+void load_cache() {
+  cache_loaded = true;
+  std::ifstream ifs(cjsh_filesystem::g_cjsh_plugin_cache_path,
+                    std::ios::binary);
+  if (!ifs.is_open()) return;
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  std::string data = ss.str();
+  cache_io::Reader in(data);
+  char magic[8];
+  uint32_t version, count;
+  if (!in.raw(magic, sizeof(magic)) ||
+      std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !in.u32(version) ||
+      version != kVersion || !in.u32(count))
+    return;
+  std::map<fs::path, CacheEntry> loaded;
+  for (uint32_t e = 0; e < count; ++e) {
+    std::string path;
+    CacheEntry entry;
+    uint64_t mtime, size;
+    uint32_t matches;
+    if (!in.str(path) || !in.u64(entry.stamp.device) ||
+        !in.u64(entry.stamp.inode) || !in.u64(mtime) ||
+        !in.u64(entry.stamp.size) || !in.u64(size) ||
+        !in.str(entry.info.format) || !in.str(entry.info.arch) ||
+        !in.u32(matches) || !in.strs(entry.info.entry_points) ||
+        !in.strs(entry.info.missing_entry_points) ||
+        !in.strs(entry.info.needed) || !in.strs(entry.info.runpaths) ||
+        !in.str(entry.info.error))
+      return;
+    entry.stamp.mtime = (int64_t)mtime;
+    entry.info.path = path;
+    entry.info.size = size;
+    entry.info.arch_matches_host = matches != 0;
+    loaded[path] = std::move(entry);
+  }
+  cache = std::move(loaded);
+}
+
+// layout: magic, version, count, then per plugin its path, stamp and
+// inspection without missing_deps, every string as a u32 length and the
+// bytes and every list as a u32 count and the strings
+bool save_cache() {
+  const fs::path& file = cjsh_filesystem::g_cjsh_plugin_cache_path;
+  fs::path tmp = file;
+  tmp += ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) return false;
+    ofs.write(kMagic, sizeof(kMagic));
+    cache_io::write_u32(ofs, kVersion);
+    cache_io::write_u32(ofs, (uint32_t)cache.size());
+    for (auto& [path, entry] : cache) {
+      const PluginInfo& info = entry.info;
+      cache_io::write_str(ofs, path.string());
+      cache_io::write_u64(ofs, entry.stamp.device);
+      cache_io::write_u64(ofs, entry.stamp.inode);
+      cache_io::write_u64(ofs, (uint64_t)entry.stamp.mtime);
+      cache_io::write_u64(ofs, entry.stamp.size);
+      cache_io::write_u64(ofs, (uint64_t)info.size);
+      cache_io::write_str(ofs, info.format);
+      cache_io::write_str(ofs, info.arch);
+      cache_io::write_u32(ofs, info.arch_matches_host ? 1 : 0);
+      cache_io::write_strs(ofs, info.entry_points);
+      cache_io::write_strs(ofs, info.missing_entry_points);
+      cache_io::write_strs(ofs, info.needed);
+      cache_io::write_strs(ofs, info.runpaths);
+      cache_io::write_str(ofs, info.error);
+    }
+    if (!ofs) return false;
+  }
+  std::error_code ec;
+  fs::rename(tmp, file, ec);
+  if (ec) fs::remove(tmp, ec);
+  return !ec;
+}
+
+}  // namespace
+
+PluginInfo inspect(const fs::path& path) {
+  PluginInfo info;
+  info.path = path;
+  info.format = "unknown";
+  MappedFile file(path);
+  info.size = file.size();
+  if (!file.data()) {
+    info.error = "cannot read file";
+    return info;
+  }
+  const unsigned char* d = file.data();
+  if (file.in_bounds(0, 4) && d[0] == 0x7f && d[1] == 'E' && d[2] == 'L' &&
+      d[3] == 'F') {
+#ifdef __linux__
+    if (!file.in_bounds(0, EI_NIDENT)) {
+      info.error = "truncated ELF header";
+      return info;
+    }
+    bool little = d[EI_DATA] == ELFDATA2LSB;
+    bool host_little = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+    if (little != host_little) {
+      info.format = d[EI_CLASS] == ELFCLASS64 ? "ELF64" : "ELF32";
+      info.error = "foreign byte order";
+      return info;
+    }
+    if (d[EI_CLASS] == ELFCLASS64) {
+      info.format = "ELF64";
+      parse_elf<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, Elf64_Dyn>(file, info);
+    } else {
+      info.format = "ELF32";
+      parse_elf<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, Elf32_Dyn>(file, info);
+    }
+#else
+    info.format = "ELF";
+    info.error = "foreign binary format";
+#endif
+    return info;
+  }
+  uint32_t magic = 0;
+  if (file.in_bounds(0, 4)) std::memcpy(&magic, d, sizeof(magic));
+  if (magic == 0xfeedfacf || magic == 0xfeedface) {
+    parse_macho(file, info);
+    return info;
+  }
+  info.error = "not a shared library";
+  return info;
+}
+
+std::vector<PluginInfo> inspect_directory(const fs::path& dir) {
+  std::vector<fs::path> paths;
+  std::error_code ec;
+  for (auto& entry : fs::directory_iterator(dir, ec)) {
+    auto ext = entry.path().extension().string();
+    if (ext == ".dylib" || ext == ".so") paths.push_back(entry.path());
+  }
+  std::sort(paths.begin(), paths.end());
+
+  std::vector<PluginInfo> results(paths.size());
+  std::vector<cjsh_filesystem::FileStamp> stamps(paths.size());
+  std::vector<bool> stamped(paths.size(), false);
+  std::vector<bool> cached(paths.size(), false);
+  bool changed = false;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (!cache_loaded) load_cache();
+    for (size_t i = 0; i < paths.size(); ++i) {
+      stamped[i] = cjsh_filesystem::file_stamp(paths[i], stamps[i]);
+      if (!stamped[i]) continue;
+      auto it = cache.find(paths[i]);
+      if (it != cache.end() && same_file(it->second.stamp, stamps[i])) {
+        results[i] = it->second.info;
+        cached[i] = true;
+      }
+    }
+    // forget plugins that were removed from dir
+    for (auto it = cache.begin(); it != cache.end();) {
+      if (it->first.parent_path() == dir &&
+          !std::binary_search(paths.begin(), paths.end(), it->first)) {
+        it = cache.erase(it);
+        changed = true;
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // cached plugins still have their dependencies looked up again
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i; (i = next++) < paths.size();) {
+      if (cached[i])
+        resolve_deps(results[i]);
+      else
+        results[i] = inspect(paths[i]);
+    }
+  };
+  size_t threads = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), paths.size());
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < threads; ++t) pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool) t.join();
+
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (cached[i] || !stamped[i]) continue;
+    cache[paths[i]] = {stamps[i], results[i]};
+    changed = true;
+  }
+  if (changed) save_cache();
+  return results;
+}
+
+}  // namespace plugin_inspector
@@ -0,0 +1,354 @@
+#include "../include/theme_preview.h"
+
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "../include/cache_io.h"
+#include "../include/cjsh_filesystem.h"
+
+namespace theme_preview {
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'J', 'T', 'H', 'E', 'M', 'E', '\0'};
+constexpr uint32_t kVersion = 1;
+
+// just enough JSON to walk to ps1_segments and read string fields
+class JsonScanner {
+ public:
+  explicit JsonScanner(const std::string& text) : s_(text) {}
+
+  bool seek_key(const std::string& key) {
+    size_t pos = s_.find("\"" + key + "\"");
+    if (pos == std::string::npos) return false;
+    i_ = pos + key.size() + 2;
+    skip_ws();
+    if (!eat(':')) return false;
+    skip_ws();
+    return true;
+  }
+
+  bool eat(char c) {
+    if (i_ < s_.size() && s_[i_] == c) {
+      ++i_;
+      return true;
+    }
+    return false;
+  }
+
+  bool peek(char c) const { return i_ < s_.size() && s_[i_] == c; }
+  bool done() const { return i_ >= s_.size(); }
+
+  void skip_ws() {
+    while (i_ < s_.size() && std::isspace((unsigned char)s_[i_])) ++i_;
+  }
+
+  bool read_string(std::string& out) {
+    out.clear();
+    if (!eat('"')) return false;
+    while (i_ < s_.size() && s_[i_] != '"') {
+      char c = s_[i_++];
+      if (c == '\\' && i_ < s_.size()) {
+        char e = s_[i_++];
+        switch (e) {
+          case 'n':
+            out += '\n';
+            break;
+          case 't':
+            out += '\t';
+            break;
+          case 'u': {
+            // \uXXXX, enough for the powerline glyphs themes use
+            unsigned cp = std::strtoul(s_.substr(i_, 4).c_str(), nullptr, 16);
+            i_ += 4;
+            if (cp < 0x80) {
+              out += (char)cp;
+            } else if (cp < 0x800) {
+              out += (char)(0xc0 | (cp >> 6));
+              out += (char)(0x80 | (cp & 0x3f));
+            } else {
+              out += (char)(0xe0 | (cp >> 12));
+              out += (char)(0x80 | ((cp >> 6) & 0x3f));
+              out += (char)(0x80 | (cp & 0x3f));
+            }
+          } break;
+          default:
+            out += e;
+        }
+      } else {
+        out += c;
+      }
+    }
+    return eat('"');
+  }
+
+  void skip_value() {
+    skip_ws();
+    if (peek('"')) {
+      std::string ignored;
+      read_string(ignored);
+      return;
+    }
+    if (peek('{') || peek('[')) {
+      int depth = 0;
+      while (i_ < s_.size()) {
+        if (peek('"')) {
+          std::string ignored;
+          read_string(ignored);
+          continue;
+        }
+        char c = s_[i_++];
+        if (c == '{' || c == '[') depth++;
+        if ((c == '}' || c == ']') && --depth == 0) return;
+      }
+      return;
+    }
+    while (i_ < s_.size() && s_[i_] != ',' && s_[i_] != '}' && s_[i_] != ']')
+      ++i_;
+  }
+
+ private:
+  const std::string& s_;
+  size_t i_ = 0;
+};
+
+bool parse_segment(JsonScanner& json, Segment& seg) {
+  if (!json.eat('{')) return false;
+  json.skip_ws();
+  while (!json.done() && !json.eat('}')) {
+    std::string key, value;
+    if (!json.read_string(key)) return false;
+    json.skip_ws();
+    if (!json.eat(':')) return false;
+    json.skip_ws();
+    if (json.peek('"')) {
+      json.read_string(value);
+      if (key == "content") seg.content = value;
+      if (key == "fg_color") seg.fg_color = value;
+      if (key == "bg_color") seg.bg_color = value;
+      if (key == "separator") seg.separator = value;
+      if (key == "separator_fg") seg.separator_fg = value;
+      if (key == "separator_bg") seg.separator_bg = value;
+    } else {
+      json.skip_value();
+    }
+    json.skip_ws();
+    json.eat(',');
+    json.skip_ws();
+  }
+  return true;
+}
+
+}  // namespace
+
+ParsedTheme parse_theme(const fs::path& path) {
+  ParsedTheme theme;
+  cjsh_filesystem::FileStamp stamp;
+  cjsh_filesystem::file_stamp(path, stamp);
+  theme.mtime = stamp.mtime;
+  theme.size = stamp.size;
+  std::ifstream ifs(path, std::ios::binary);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  std::string text = ss.str();
+  JsonScanner json(text);
+  if (!json.seek_key("ps1_segments") || !json.eat('[')) return theme;
+  json.skip_ws();
+  while (!json.done() && !json.eat(']')) {
+    Segment seg;
+    if (!parse_segment(json, seg)) break;
+    theme.segments.push_back(std::move(seg));
+    json.skip_ws();
+    json.eat(',');
+    json.skip_ws();
+  }
+  return theme;
+}
+
+ThemeCache::ThemeCache(fs::path cache_file)
+    : cache_file_(std::move(cache_file)) {
+  load();
+}
+
+ThemeCache::~ThemeCache() {
+  if (prune() || dirty_) save();
+}
+
+const ParsedTheme& ThemeCache::get(const fs::path& path) {
+  cjsh_filesystem::FileStamp stamp;
+  cjsh_filesystem::file_stamp(path, stamp);
+  auto it = themes_.find(path.string());
+  if (it != themes_.end() && it->second.mtime == stamp.mtime &&
+      it->second.size == stamp.size)
+    return it->second;
+  dirty_ = true;
+  return themes_[path.string()] = parse_theme(path);
+}
+
+// layout: magic, version, count, then per theme its path, mtime, size and
+// segments, every string as a u32 length and the bytes
+bool ThemeCache::save() {
+  prune();
+  // a name of our own so two configurators never write the same temp file
+  fs::path tmp = cache_file_;
+  tmp += ".tmp." + std::to_string(getpid());
+  std::error_code ec;
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) return false;
+    ofs.write(kMagic, sizeof(kMagic));
+    cache_io::write_u32(ofs, kVersion);
+    cache_io::write_u32(ofs, (uint32_t)themes_.size());
+    for (auto& [path, theme] : themes_) {
+      cache_io::write_str(ofs, path);
+      cache_io::write_u64(ofs, (uint64_t)theme.mtime);
+      cache_io::write_u64(ofs, theme.size);
+      cache_io::write_u32(ofs, (uint32_t)theme.segments.size());
+      for (auto& seg : theme.segments) {
+        for (const std::string* s :
+             {&seg.content, &seg.fg_color, &seg.bg_color, &seg.separator,
+              &seg.separator_fg, &seg.separator_bg})
+          cache_io::write_str(ofs, *s);
+      }
+    }
+    if (!ofs) {
+      ofs.close();
+      fs::remove(tmp, ec);
+      return false;
+    }
+  }
+  fs::rename(tmp, cache_file_, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+// drops themes whose file was deleted, true if any were
+bool ThemeCache::prune() {
+  bool removed = false;
+  for (auto it = themes_.begin(); it != themes_.end();) {
+    std::error_code ec;
+    if (!fs::exists(it->first, ec) && !ec) {
+      it = themes_.erase(it);
+      removed = true;
+    } else {
+      ++it;
+    }
+  }
+  return removed;
+}
+
+void ThemeCache::load() {
+  std::ifstream ifs(cache_file_, std::ios::binary);
+  if (!ifs.is_open()) return;
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  std::string data = ss.str();
+  cache_io::Reader in(data);
+  char magic[8];
+  uint32_t version, count;
+  if (!in.raw(magic, sizeof(magic)) ||
+      std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !in.u32(version) ||
+      version != kVersion || !in.u32(count))
+    return;
+  std::map<std::string, ParsedTheme> loaded;
+  for (uint32_t t = 0; t < count; ++t) {
+    std::string path;
+    ParsedTheme theme;
+    uint64_t mtime;
+    uint32_t segments;
+    if (!in.str(path) || !in.u64(mtime) || !in.u64(theme.size) ||
+        !in.u32(segments))
+      return;
+    theme.mtime = (int64_t)mtime;
+    for (uint32_t s = 0; s < segments; ++s) {
+      Segment seg;
+      for (std::string* str :
+           {&seg.content, &seg.fg_color, &seg.bg_color, &seg.separator,
+            &seg.separator_fg, &seg.separator_bg})
+        if (!in.str(*str)) return;
+      theme.segments.push_back(std::move(seg));
+    }
+    loaded[path] = std::move(theme);
+  }
+  themes_ = std::move(loaded);
+}
+
+bool color_rgb(const std::string& color, int& r, int& g, int& b) {
+  if (color.size() == 7 && color[0] == '#') {
+    unsigned long v = std::strtoul(color.c_str() + 1, nullptr, 16);
+    r = (v >> 16) & 0xff;
+    g = (v >> 8) & 0xff;
+    b = v & 0xff;
+    return true;
+  }
+  std::string name;
+  for (char c : color) name += (char)std::toupper((unsigned char)c);
+  bool bright = name.rfind("BRIGHT_", 0) == 0;
+  if (bright) name = name.substr(7);
+  static const std::map<std::string, int> basic = {
+      {"BLACK", 0x000000}, {"RED", 0xcd0000},     {"GREEN", 0x00cd00},
+      {"YELLOW", 0xcdcd00}, {"BLUE", 0x0000ee},   {"MAGENTA", 0xcd00cd},
+      {"CYAN", 0x00cdcd},  {"WHITE", 0xe5e5e5}};
+  auto it = basic.find(name);
+  if (it == basic.end()) return false;
+  int v = it->second;
+  r = (v >> 16) & 0xff;
+  g = (v >> 8) & 0xff;
+  b = v & 0xff;
+  if (bright) {
+    r = r ? 0xff : 0x7f;
+    g = g ? 0xff : 0x7f;
+    b = b ? 0xff : 0x7f;
+  }
+  return true;
+}
+
+std::string sample_content(const std::string& content) {
+  static const std::map<std::string, std::string> samples = []() {
+    std::map<std::string, std::string> m;
+    const char* user = std::getenv("USER");
+    m["USERNAME"] = user ? user : "user";
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    m["HOSTNAME"] = host;
+    m["PATH"] = "~/projects/cjsh";
+    m["LOCAL_PATH"] = "~/projects/cjsh";
+    m["DIRECTORY"] = "cjsh";
+    m["GIT_BRANCH"] = "main";
+    m["GIT_STATUS"] = "*";
+    m["TIME"] = "12:34:56";
+    m["TIME24"] = "12:34:56";
+    m["TIME12"] = "12:34:56 PM";
+    m["SHELL"] = "cjsh";
+    return m;
+  }();
+  std::string out;
+  for (size_t i = 0; i < content.size(); ++i) {
+    size_t end;
+    if (content[i] == '{' &&
+        (end = content.find('}', i)) != std::string::npos) {
+      std::string key = content.substr(i + 1, end - i - 1);
+      auto it = samples.find(key);
+      if (it != samples.end()) {
+        out += it->second;
+      } else {
+        for (char c : key) out += (char)std::tolower((unsigned char)c);
+      }
+      i = end;
+    } else {
+      out += content[i];
+    }
+  }
+  return out;
+}
+
+}  // namespace theme_preview
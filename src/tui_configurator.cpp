@@ -1,14 +1,32 @@
 #include "../include/tui_configurator.h"
 
+#include <fcntl.h>
 #include <ncurses.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "../include/cjsh_filesystem.h"
+#include "../include/cjsh_snapshot.h"
+#include "../include/cjsh_store.h"
+#include "../include/event_loop.h"
+#include "../include/history_suggest.h"
+#include "../include/line_diff.h"
+#include "../include/list_filter.h"
+#include "../include/plugin_inspector.h"
+#include "../include/theme_preview.h"
 
 const std::string version = "1.0.0";
 const std::string main_repo_plugins = "github.com/cadenfinley/cjsshell/plugins";
@@ -34,24 +52,28 @@ static const std::vector<std::string> edit_items_cjshrc = {
     "3) Set environment variable",
     "4) Set theme",
     "5) Add plugin",
-    "6) Remove line",
-    "7) Wipe file",
-    "8) Exit",
+    "6) Suggest aliases",
+    "7) Remove line",
+    "8) Wipe file",
+    "9) Exit",
 };
 static const std::vector<std::string> edit_items_cjprofile = {
     "1) Set alias",
     "2) Add startup command",
     "3) Set environment variable",
     "4) Add startup argument",
-    "5) Remove line",
-    "6) Wipe file",
-    "7) Exit",
+    "5) Suggest aliases",
+    "6) Remove line",
+    "7) Wipe file",
+    "8) Exit",
 };
 
 static const std::vector<std::string> theme_menu = {
-    "1) Download Themes", "2) Uninstall Themes", "3) Exit"};
+    "1) Download Themes", "2) Uninstall Themes", "3) Clean Download Store",
+    "4) Exit"};
 static const std::vector<std::string> plugin_menu = {
-    "1) Download Plugins", "2) Uninstall Plugins", "3) Exit"};
+    "1) Download Plugins", "2) Uninstall Plugins", "3) Clean Download Store",
+    "4) Exit"};
 
 // new: GitHub API endpoints
 static const std::string api_themes_url =
@@ -59,64 +81,375 @@ static const std::string api_themes_url =
 static const std::string api_plugins_url =
     "https://api.github.com/repos/cadenfinley/cjsshell/contents/plugins";
 
-// new: fetch JSON directory listing and extract "name" fields
-static std::vector<std::string> fetch_remote_list(const std::string& url) {
+struct RemoteItem {
+  std::string name;
+  std::string download_url;  // "null" for directories
+};
+
+// a curl the configurator started on a worker. cancelling kills it, so
+// leaving a screen never waits on the network
+struct ChildProcess {
+  std::mutex mutex;
+  pid_t pid = 0;
+  bool cancelled = false;
+  bool finished = false;
+
+  void cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+    if (pid > 0) kill(-pid, SIGTERM);
+  }
+};
+
+// runs args to completion, collecting stdout into output when given. true
+// when it exited 0 without being cancelled
+static bool run_child(const std::vector<std::string>& args,
+                      ChildProcess& child, std::string* output) {
+  std::vector<char*> argv;
+  for (auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+  argv.push_back(nullptr);
+  // close-on-exec so children forked by other workers cannot hold the pipe
+  // open past this one
+  int fds[2] = {-1, -1};
+  if (output && pipe2(fds, O_CLOEXEC) != 0) return false;
+  // the child leads its own process group, so a kill also reaches anything
+  // it started that could keep the pipe open
+  pid_t pid = fork();
+  if (pid == 0) {
+    setpgid(0, 0);
+    if (output) dup2(fds[1], STDOUT_FILENO);
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  if (output) close(fds[1]);
+  {
+    std::lock_guard<std::mutex> lock(child.mutex);
+    if (pid > 0) {
+      setpgid(pid, pid);
+      child.pid = pid;
+      if (child.cancelled) kill(-pid, SIGTERM);
+    }
+  }
+  if (output) {
+    char buffer[4096];
+    ssize_t n;
+    while (pid > 0 && ((n = read(fds[0], buffer, sizeof(buffer))) > 0 ||
+                       (n < 0 && errno == EINTR)))
+      if (n > 0) output->append(buffer, n);
+    close(fds[0]);
+  }
+  int status = 0;
+  bool ok = pid > 0 && waitpid(pid, &status, 0) == pid &&
+            WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  std::lock_guard<std::mutex> lock(child.mutex);
+  child.pid = 0;
+  child.finished = true;
+  return ok && !child.cancelled;
+}
+
+// extract every value of a field from a JSON document
+static std::vector<std::string> json_field_values(const std::string& json,
+                                                  const std::string& field) {
   std::vector<std::string> items;
-  FILE* pipe = popen(("curl -s " + url).c_str(), "r");
-  if (!pipe) return items;
-  char buffer[4096];
-  std::string result;
-  while (fgets(buffer, sizeof(buffer), pipe)) result += buffer;
-  pclose(pipe);
-  const std::string key = "\"name\":";
+  const std::string key = "\"" + field + "\":";
   size_t pos = 0;
-  while ((pos = result.find(key, pos)) != std::string::npos) {
+  while ((pos = json.find(key, pos)) != std::string::npos) {
     pos += key.length();
-    while (pos < result.size() &&
-           (result[pos] == ' ' || result[pos] == '\"' || result[pos] == ':'))
+    while (pos < json.size() &&
+           (json[pos] == ' ' || json[pos] == '\"' || json[pos] == ':'))
       pos++;
-    size_t end = result.find_first_of("\",", pos);
+    size_t end = json.find_first_of("\",", pos);
     if (end != std::string::npos) {
-      items.push_back(result.substr(pos, end - pos));
+      items.push_back(json.substr(pos, end - pos));
       pos = end;
     }
   }
   return items;
 }
 
+// new: fetch JSON directory listing
+static std::vector<RemoteItem> fetch_remote_list(const std::string& url,
+                                                 ChildProcess& child) {
+  std::vector<RemoteItem> items;
+  std::string result;
+  if (!run_child({"curl", "-sfL", "--max-time", "30", url}, child, &result))
+    return items;
+  auto names = json_field_values(result, "name");
+  auto urls = json_field_values(result, "download_url");
+  for (size_t i = 0; i < names.size(); ++i)
+    items.push_back({names[i], i < urls.size() ? urls[i] : "null"});
+  return items;
+}
+
+// "Press any key..." and y/n prompts that keep timers, watches and workers
+// running. returns the key
+static int wait_key() {
+  int key = ERR;
+  EventLoop::instance().run([]() {}, [&key](int c) {
+    key = c;
+    return false;
+  });
+  return key;
+}
+
+// runs work on a worker thread with a spinner; any key cancels, in which case
+// false is returned and result is left alone
+template <typename T>
+static bool run_with_spinner(const std::string& title,
+                             const std::string& status,
+                             std::function<T()> work, T& result) {
+  struct TaskState {
+    bool cancelled = false;
+    bool finished = false;
+    T result;
+  };
+  auto state = std::make_shared<TaskState>();
+  auto& loop = EventLoop::instance();
+  run_in_background<T>(std::move(work), [state, &loop](T r) {
+    if (state->cancelled) return;
+    state->result = std::move(r);
+    state->finished = true;
+    loop.quit();
+  });
+
+  static const char spinner[] = "|/-\\";
+  int frame = 0;
+  int timer = loop.add_timer(
+      std::chrono::milliseconds(100),
+      [&]() {
+        frame++;
+        loop.request_redraw();
+      },
+      true);
+  loop.run(
+      [&]() {
+        clear();
+        mvprintw(0, 0, title.c_str());
+        mvprintw(2, 0, "%s %c  (press any key to cancel)", status.c_str(),
+                 spinner[frame % 4]);
+      },
+      [&](int) {
+        state->cancelled = true;
+        return false;
+      });
+  loop.cancel_timer(timer);
+  if (!state->finished) return false;
+  result = std::move(state->result);
+  return true;
+}
+
+// puts item into dir, straight from the store when it was installed before
+static std::string install_remote_item(const RemoteItem& item,
+                                       const cjsh_filesystem::fs::path& dir,
+                                       const std::string& title) {
+  auto dest = dir / cjsh_filesystem::fs::path(item.name).filename();
+  if (!cjsh_filesystem::fs::exists(dest) && cjsh_store::restore(dest))
+    return "Reinstalled from store.";
+  if (item.download_url.empty() || item.download_url == "null")
+    return "Nothing to download.";
+  auto tmp = cjsh_filesystem::g_cjsh_cache_path / (dest.filename().string() +
+                                                   ".download");
+  // whoever sees the cancel last removes the partial file
+  auto download = std::make_shared<ChildProcess>();
+  std::string url = item.download_url;
+  bool downloaded = false;
+  if (!run_with_spinner<bool>(
+          title, "Downloading " + item.name,
+          [url, tmp, download]() {
+            std::string out = tmp.string();
+            bool ok = run_child(
+                {"curl", "-sfL", "--connect-timeout", "30", "-o", out, url},
+                *download, nullptr);
+            std::lock_guard<std::mutex> lock(download->mutex);
+            if (download->cancelled) {
+              std::error_code ec;
+              cjsh_filesystem::fs::remove(out, ec);
+            }
+            return ok;
+          },
+          downloaded)) {
+    download->cancel();
+    std::lock_guard<std::mutex> lock(download->mutex);
+    if (download->finished) {
+      std::error_code ec;
+      cjsh_filesystem::fs::remove(tmp, ec);
+    }
+    return "Cancelled.";
+  }
+  std::string message = "Download failed.";
+  if (downloaded)
+    message = cjsh_store::install(tmp, dest) ? "Installed." : "Install failed.";
+  std::error_code ec;
+  cjsh_filesystem::fs::remove(tmp, ec);
+  return message;
+}
+
+static void install_remote_menu(const std::string& url,
+                                const std::string& title,
+                                const cjsh_filesystem::fs::path& dir) {
+  std::vector<RemoteItem> items;
+  auto fetch = std::make_shared<ChildProcess>();
+  if (!run_with_spinner<std::vector<RemoteItem>>(
+          title, "Fetching",
+          [url, fetch]() { return fetch_remote_list(url, *fetch); }, items)) {
+    fetch->cancel();
+    return;
+  }
+  clear();
+  mvprintw(0, 0, title.c_str());
+  for (size_t i = 0; i < items.size(); ++i)
+    mvprintw((int)i + 1, 0, "%zu) %s", i + 1, items[i].name.c_str());
+  int row = (int)items.size() + 2;
+  mvprintw(row, 0, "Install # (empty to go back): ");
+  echo();
+  curs_set(1);
+  char num[16];
+  getnstr(num, 15);
+  noecho();
+  curs_set(0);
+  if (num[0] == '\0') return;
+  int idx = atoi(num) - 1;
+  std::string message = "Invalid selection.";
+  if (idx >= 0 && idx < (int)items.size())
+    message = install_remote_item(items[idx], dir, title);
+  clear();
+  mvprintw(0, 0, title.c_str());
+  mvprintw(2, 0, "%s Press any key...", message.c_str());
+  wait_key();
+}
+
+static void clean_store() {
+  auto stats = cjsh_store::collect_garbage();
+  clear();
+  mvprintw(0, 0, "Removed %zu unused downloads (%ju KiB). Press any key...",
+           stats.objects_removed, stats.bytes_freed / 1024);
+  wait_key();
+}
+
 static void showMenu(const std::string& title,
                      const std::vector<std::string>& menu) {
   int choice = 0;
-  while (true) {
-    clear();
-    {
-      int rows, cols;
-      getmaxyx(stdscr, rows, cols);
-      int splash_col = cols / 2;
-      for (size_t i = 0; i < splash.size() && (int)i < rows; ++i)
-        mvprintw((int)i, splash_col, splash[i].c_str());
-    }
-    mvprintw(0, 0, title.c_str());
-    for (size_t i = 0; i < menu.size(); ++i) {
-      if ((int)i == choice) attron(A_REVERSE);
-      mvprintw((int)i + 2, 2, menu[i].c_str());
-      if ((int)i == choice) attroff(A_REVERSE);
-    }
-    int c = getch();
-    switch (c) {
-      case KEY_UP:
-        choice = (choice + menu.size() - 1) % menu.size();
-        break;
-      case KEY_DOWN:
-        choice = (choice + 1) % menu.size();
-        break;
-      case '\n':
-        if (choice == (int)menu.size() - 1) return;
-        mvprintw(menu.size() + 3, 2, "Not yet implemented. Press any key...");
-        getch();
-        break;
-    }
-  }
+  EventLoop::instance().run(
+      [&]() {
+        clear();
+        {
+          int rows, cols;
+          getmaxyx(stdscr, rows, cols);
+          int splash_col = cols / 2;
+          for (size_t i = 0; i < splash.size() && (int)i < rows; ++i)
+            mvprintw((int)i, splash_col, splash[i].c_str());
+        }
+        mvprintw(0, 0, title.c_str());
+        for (size_t i = 0; i < menu.size(); ++i) {
+          if ((int)i == choice) attron(A_REVERSE);
+          mvprintw((int)i + 2, 2, menu[i].c_str());
+          if ((int)i == choice) attroff(A_REVERSE);
+        }
+      },
+      [&](int c) {
+        switch (c) {
+          case KEY_UP:
+            choice = (choice + menu.size() - 1) % menu.size();
+            break;
+          case KEY_DOWN:
+            choice = (choice + 1) % menu.size();
+            break;
+          case '\n':
+            if (choice == (int)menu.size() - 1) return false;
+            mvprintw(menu.size() + 3, 2,
+                     "Not yet implemented. Press any key...");
+            wait_key();
+            break;
+        }
+        return true;
+      });
+}
+
+// list with a filter typed above it. labels are shown, items are what the
+// filter searches, picked is an index into both. false when cancelled
+static bool filter_pick(const std::string& title,
+                        const std::vector<std::string>& items,
+                        const std::vector<std::string>& labels,
+                        size_t& picked) {
+  list_filter::Filter filter(items);
+  std::string query;
+  size_t selected = 0;
+  size_t top = 0;
+  bool chosen = false;
+  curs_set(1);
+  EventLoop::instance().run(
+      [&]() {
+        clear();
+        const auto& matches = filter.matches();
+        size_t height = (size_t)std::max(1, LINES - 3);
+        if (selected < top) top = selected;
+        if (selected >= top + height) top = selected - height + 1;
+        mvprintw(0, 0, "%s (%zu of %zu, enter to pick, esc to cancel)",
+                 title.c_str(), matches.size(), filter.size());
+        for (size_t r = top; r < matches.size() && r < top + height; ++r) {
+          if (r == selected) attron(A_REVERSE);
+          mvprintw((int)(r - top) + 2, 0, "%s",
+                   labels[matches[r]]
+                       .substr(0, (size_t)std::max(0, COLS - 1))
+                       .c_str());
+          if (r == selected) attroff(A_REVERSE);
+        }
+        if (matches.empty()) mvprintw(2, 0, "(no matches)");
+        mvprintw(1, 0, "Filter: %s", query.c_str());
+      },
+      [&](int c) {
+        size_t count = filter.matches().size();
+        size_t page = (size_t)std::max(1, LINES - 3);
+        switch (c) {
+          case KEY_UP:
+            if (selected > 0) --selected;
+            return true;
+          case KEY_DOWN:
+            if (selected + 1 < count) ++selected;
+            return true;
+          case KEY_PPAGE:
+            selected -= std::min(selected, page);
+            return true;
+          case KEY_NPAGE:
+            if (count) selected = std::min(count - 1, selected + page);
+            return true;
+          case '\n':
+            if (count == 0) return true;
+            picked = filter.matches()[selected];
+            chosen = true;
+            return false;
+          case 27:
+            return false;
+          case KEY_BACKSPACE:
+          case 127:
+          case 8:
+            if (query.empty()) return true;
+            query.pop_back();
+            break;
+          default:
+            if (c < 32 || c > 126) return true;
+            query += (char)c;
+        }
+        filter.update(query);
+        selected = 0;
+        top = 0;
+        return true;
+      });
+  curs_set(0);
+  return chosen;
+}
+
+// replaces any alias with the same name
+static void write_alias(const std::string& path, const std::string& name,
+                        const std::string& cmd) {
+  std::vector<std::string> lines;
+  std::ifstream ifs(path);
+  std::string l;
+  while (std::getline(ifs, l))
+    if (l.rfind("alias " + name + "=", 0) != 0) lines.push_back(l);
+  std::ofstream ofs(path);
+  for (auto& ln : lines) ofs << ln << "\n";
+  ofs << "alias " << name << "='" << cmd << "'\n";
 }
 
 static void add_alias_menu(const std::string& path) {
@@ -132,20 +465,90 @@ static void add_alias_menu(const std::string& path) {
   noecho();
   curs_set(0);
 
+  write_alias(path, name, cmd);
+
+  mvprintw(3, 0, "Alias added. Press any key...");
+  wait_key();
+}
+
+// offers aliases for the commands typed most often, enter adds one
+static void suggest_aliases_menu(const std::string& path) {
+  const std::string title = "Suggest Aliases";
+  std::set<std::string> taken, aliased;
   {
-    std::vector<std::string> lines;
     std::ifstream ifs(path);
     std::string l;
-    while (std::getline(ifs, l))
-      if (l.rfind(std::string("alias ") + name + "=", 0) != 0)
-        lines.push_back(l);
-    std::ofstream ofs(path);
-    for (auto& ln : lines) ofs << ln << "\n";
-    ofs << "alias " << name << "='" << cmd << "'\n";
+    while (std::getline(ifs, l)) {
+      size_t eq = l.find('=');
+      if (l.rfind("alias ", 0) != 0 || eq == std::string::npos) continue;
+      taken.insert(l.substr(6, eq - 6));
+      std::string cmd = l.substr(eq + 1);
+      if (cmd.size() >= 2 && cmd.front() == '\'' && cmd.back() == '\'')
+        cmd = cmd.substr(1, cmd.size() - 2);
+      aliased.insert(cmd);
+    }
+    for (auto& exe : cjsh_filesystem::read_cached_executables())
+      taken.insert(exe.string());
+  }
+  std::vector<history_suggest::Suggestion> suggestions;
+  if (!run_with_spinner<std::vector<history_suggest::Suggestion>>(
+          title, "Reading history",
+          [taken, aliased]() {
+            return history_suggest::suggest(
+                cjsh_filesystem::g_cjsh_history_path,
+                history_suggest::Options(), taken, aliased);
+          },
+          suggestions))
+    return;
+  if (suggestions.empty()) {
+    clear();
+    mvprintw(0, 0, title.c_str());
+    mvprintw(2, 0, "No suggestions yet. Press any key...");
+    wait_key();
+    return;
   }
 
-  mvprintw(3, 0, "Alias added. Press any key...");
-  getch();
+  std::vector<bool> added(suggestions.size(), false);
+  int choice = 0;
+  EventLoop::instance().run(
+      [&]() {
+        clear();
+        int rows, cols;
+        getmaxyx(stdscr, rows, cols);
+        mvprintw(0, 0, "%s (enter to add, q to go back)", title.c_str());
+        for (size_t i = 0; i < suggestions.size() && (int)i < rows - 3; ++i) {
+          auto& s = suggestions[i];
+          std::string line = s.alias + " = " + s.command +
+                             (s.prefix ? " ..." : "") + "  (" +
+                             std::to_string(s.count) + " uses)" +
+                             (added[i] ? "  [added]" : "");
+          if ((int)i == choice) attron(A_REVERSE);
+          mvprintw((int)i + 2, 2, "%s", line.substr(0, cols - 3).c_str());
+          if ((int)i == choice) attroff(A_REVERSE);
+        }
+      },
+      [&](int c) {
+        int count = (int)suggestions.size();
+        switch (c) {
+          case KEY_UP:
+            choice = (choice + count - 1) % count;
+            break;
+          case KEY_DOWN:
+            choice = (choice + 1) % count;
+            break;
+          case '\n':
+            if (!added[choice]) {
+              write_alias(path, suggestions[choice].alias,
+                          suggestions[choice].command);
+              added[choice] = true;
+            }
+            break;
+          case 'q':
+          case 27:
+            return false;
+        }
+        return true;
+      });
 }
 
 static void add_startup_command_menu(const std::string& path) {
@@ -174,7 +577,7 @@ static void add_startup_command_menu(const std::string& path) {
     } else {
       mvprintw(2, 0, "Command already exists. Press any key...");
     }
-    getch();
+    wait_key();
   }
 }
 
@@ -204,18 +607,163 @@ static void add_env_var_menu(const std::string& path) {
   }
 
   mvprintw(3, 0, "Export added. Press any key...");
-  getch();
+  wait_key();
+}
+
+// nearest terminal color for a theme color, -1 for the default color
+static short curses_color(const std::string& color) {
+  int r, g, b;
+  if (!theme_preview::color_rgb(color, r, g, b)) return -1;
+  if (COLORS >= 256) {
+    auto level = [](int v) { return v < 48 ? 0 : v < 115 ? 1 : (v - 35) / 40; };
+    return (short)(16 + 36 * level(r) + 6 * level(g) + level(b));
+  }
+  return (short)((r > 127 ? COLOR_RED : 0) | (g > 127 ? COLOR_GREEN : 0) |
+                 (b > 127 ? COLOR_BLUE : 0));
+}
+
+// pairs are handed out again from 1 on every frame
+static short preview_pair(const std::string& fg, const std::string& bg,
+                          short& next_pair) {
+  if (!has_colors() || next_pair >= COLOR_PAIRS) return 0;
+  init_pair(next_pair, curses_color(fg), curses_color(bg));
+  return next_pair++;
+}
+
+static void draw_theme_preview(const theme_preview::ParsedTheme& theme,
+                               int row, int col, int width) {
+  short next_pair = 1;
+  move(row, col);
+  int used = 0;
+  auto put = [&](const std::string& text, short pair) {
+    std::string clipped = text.substr(0, std::max(0, width - used));
+    if (clipped.empty()) return;
+    attron(COLOR_PAIR(pair));
+    printw("%s", clipped.c_str());
+    attroff(COLOR_PAIR(pair));
+    used += (int)clipped.size();
+  };
+  for (auto& seg : theme.segments) {
+    put(theme_preview::sample_content(seg.content),
+        preview_pair(seg.fg_color, seg.bg_color, next_pair));
+    if (!seg.separator.empty())
+      put(seg.separator,
+          preview_pair(seg.separator_fg, seg.separator_bg, next_pair));
+  }
+  if (theme.segments.empty()) mvprintw(row, col, "(no ps1_segments)");
+  int line = row + 2;
+  for (auto& seg : theme.segments) {
+    std::string detail = seg.content + "  fg " + seg.fg_color + "  bg " +
+                         seg.bg_color;
+    mvprintw(line++, col, "%s", detail.substr(0, width).c_str());
+  }
+}
+
+static std::vector<cjsh_filesystem::fs::path> installed_themes() {
+  std::vector<cjsh_filesystem::fs::path> themes;
+  std::error_code ec;
+  for (auto& entry : cjsh_filesystem::fs::directory_iterator(
+           cjsh_filesystem::g_cjsh_theme_path, ec)) {
+    if (entry.path().extension() == ".json") themes.push_back(entry.path());
+  }
+  std::sort(themes.begin(), themes.end());
+  return themes;
+}
+
+// lists installed themes with a live preview of the highlighted one. only
+// the rows on screen are parsed, through the cache. false when cancelled
+static bool pick_theme(std::vector<cjsh_filesystem::fs::path> themes,
+                       std::string& picked) {
+  auto& loop = EventLoop::instance();
+  theme_preview::ThemeCache cache(cjsh_filesystem::g_cjsh_theme_cache_path);
+  int selected = 0;
+  int top = 0;
+  bool chosen = false;
+  int watch = loop.add_watch(cjsh_filesystem::g_cjsh_theme_path, [&]() {
+    themes = installed_themes();
+    selected = std::min(selected, std::max(0, (int)themes.size() - 1));
+    loop.request_redraw();
+  });
+  loop.run(
+      [&]() {
+        clear();
+        int rows, cols;
+        getmaxyx(stdscr, rows, cols);
+        int list_height = std::max(1, rows - 3);
+        int preview_col = cols / 2;
+        if (selected < top) top = selected;
+        if (selected >= top + list_height) top = selected - list_height + 1;
+        mvprintw(0, 0, "Select Theme (enter to set, q to cancel)");
+        for (int i = top; i < (int)themes.size() && i < top + list_height;
+             ++i) {
+          const auto& theme = cache.get(themes[i]);
+          std::string line = themes[i].stem().string() + " (" +
+                             std::to_string(theme.segments.size()) +
+                             " segments)";
+          if (i == selected) attron(A_REVERSE);
+          mvprintw(i - top + 2, 2, "%s",
+                   line.substr(0, std::max(0, preview_col - 3)).c_str());
+          if (i == selected) attroff(A_REVERSE);
+        }
+        mvprintw(0, preview_col, "Preview:");
+        if (!themes.empty())
+          draw_theme_preview(cache.get(themes[selected]), 2, preview_col,
+                             cols - preview_col - 1);
+      },
+      [&](int c) {
+        int count = (int)themes.size();
+        int page = std::max(1, LINES - 3);
+        switch (c) {
+          case KEY_UP:
+            if (count) selected = (selected + count - 1) % count;
+            break;
+          case KEY_DOWN:
+            if (count) selected = (selected + 1) % count;
+            break;
+          case KEY_PPAGE:
+            selected = std::max(0, selected - page);
+            break;
+          case KEY_NPAGE:
+            selected = std::max(0, std::min(count - 1, selected + page));
+            break;
+          case KEY_HOME:
+            selected = 0;
+            break;
+          case KEY_END:
+            selected = std::max(0, count - 1);
+            break;
+          case '\n':
+            if (count == 0) return false;
+            picked = themes[selected].stem().string();
+            chosen = true;
+            return false;
+          case 'q':
+          case 27:
+            return false;
+        }
+        return true;
+      });
+  loop.remove_watch(watch);
+  return chosen;
 }
 
 static void add_theme_menu(const std::string& path) {
-  clear();
-  mvprintw(0, 0, "Theme name: ");
-  echo();
-  curs_set(1);
-  char theme[128];
-  getnstr(theme, 127);
-  noecho();
-  curs_set(0);
+  std::string theme;
+  auto themes = installed_themes();
+  if (!themes.empty()) {
+    if (!pick_theme(std::move(themes), theme)) return;
+    clear();
+  } else {
+    clear();
+    mvprintw(0, 0, "Theme name: ");
+    echo();
+    curs_set(1);
+    char name[128];
+    getnstr(name, 127);
+    noecho();
+    curs_set(0);
+    theme = name;
+  }
 
   {
     std::vector<std::string> lines;
@@ -229,7 +777,7 @@ static void add_theme_menu(const std::string& path) {
   }
 
   mvprintw(2, 0, "Theme set. Press any key...");
-  getch();
+  wait_key();
 }
 
 static void add_plugin_menu(const std::string& path) {
@@ -245,7 +793,7 @@ static void add_plugin_menu(const std::string& path) {
   std::ofstream ofs(path, std::ios::app);
   ofs << "plugin " << plugin << " enable\n";
   mvprintw(2, 0, "Plugin added. Press any key...");
-  getch();
+  wait_key();
 }
 
 static void add_startup_arg(const std::string& path) {
@@ -274,7 +822,7 @@ static void add_startup_arg(const std::string& path) {
     } else {
       mvprintw(2, 0, "Argument already exists. Press any key...");
     }
-    getch();
+    wait_key();
   }
 }
 
@@ -288,85 +836,75 @@ static void list_themes() {
     if (ext == ".json") mvprintw(row++, 0, entry.path().filename().c_str());
   }
   mvprintw(row + 1, 0, "Press any key...");
-  getch();
+  wait_key();
 }
 
 static void manageThemes() {
+  auto& loop = EventLoop::instance();
   int choice = 0;
-  while (true) {
-    clear();
-    mvprintw(0, 0, "Manage Themes");
-    {
-      int rows, cols;
-      getmaxyx(stdscr, rows, cols);
-      int list_col = cols / 2;
-      mvprintw(0, list_col, "Installed Themes:");
-      int row = 1;
-      for (auto& entry : cjsh_filesystem::fs::directory_iterator(
-               cjsh_filesystem::g_cjsh_theme_path)) {
-        if (entry.path().extension() == ".json")
-          mvprintw(row++, list_col, entry.path().filename().c_str());
-      }
-    }
-    for (size_t i = 0; i < theme_menu.size(); ++i) {
-      if ((int)i == choice) attron(A_REVERSE);
-      mvprintw((int)i + 2, 2, theme_menu[i].c_str());
-      if ((int)i == choice) attroff(A_REVERSE);
-    }
-    int c = getch();
-    switch (c) {
-      case KEY_UP:
-        choice = (choice + theme_menu.size() - 1) % theme_menu.size();
-        break;
-      case KEY_DOWN:
-        choice = (choice + 1) % theme_menu.size();
-        break;
-      case '\n':
-        if (choice == 0) {
-          auto items = fetch_remote_list(api_themes_url);
-          clear();
-          mvprintw(0, 0, "Available Themes:");
+  int watch = loop.add_watch(cjsh_filesystem::g_cjsh_theme_path,
+                             [&loop]() { loop.request_redraw(); });
+  loop.run(
+      [&]() {
+        clear();
+        mvprintw(0, 0, "Manage Themes");
+        {
+          int rows, cols;
+          getmaxyx(stdscr, rows, cols);
+          int list_col = cols / 2;
+          mvprintw(0, list_col, "Installed Themes:");
           int row = 1;
-          for (auto& name : items) mvprintw(row++, 0, name.c_str());
-          mvprintw(row + 1, 0, "Press any key...");
-          getch();
-        } else if (choice == 1) {
-          clear();
-          mvprintw(0, 0, "Uninstall Themes:");
-          std::vector<cjsh_filesystem::fs::path> themes;
           for (auto& entry : cjsh_filesystem::fs::directory_iterator(
                    cjsh_filesystem::g_cjsh_theme_path)) {
             if (entry.path().extension() == ".json")
-              themes.push_back(entry.path());
-          }
-          for (size_t i = 0; i < themes.size(); ++i)
-            mvprintw((int)i + 1, 0, "%zu) %s", i + 1,
-                     themes[i].filename().c_str());
-          mvprintw((int)themes.size() + 2, 0, "Select theme #: ");
-          echo();
-          curs_set(1);
-          char num[16];
-          getnstr(num, 15);
-          noecho();
-          curs_set(0);
-          int idx = atoi(num) - 1;
-          if (idx >= 0 && idx < (int)themes.size()) {
-            cjsh_filesystem::fs::remove(themes[idx]);
-            mvprintw((int)themes.size() + 4, 0, "Deleted. Press any key...");
-          } else {
-            mvprintw((int)themes.size() + 4, 0,
-                     "Invalid selection. Press any key...");
+              mvprintw(row++, list_col, entry.path().filename().c_str());
           }
-          getch();
-        } else if (choice == (int)theme_menu.size() - 1) {
-          return;
-        } else {
-          mvprintw(0, 0, "Not yet implemented. Press any key...");
-          getch();
         }
-        break;
-    }
-  }
+        for (size_t i = 0; i < theme_menu.size(); ++i) {
+          if ((int)i == choice) attron(A_REVERSE);
+          mvprintw((int)i + 2, 2, theme_menu[i].c_str());
+          if ((int)i == choice) attroff(A_REVERSE);
+        }
+      },
+      [&](int c) {
+        switch (c) {
+          case KEY_UP:
+            choice = (choice + theme_menu.size() - 1) % theme_menu.size();
+            break;
+          case KEY_DOWN:
+            choice = (choice + 1) % theme_menu.size();
+            break;
+          case '\n':
+            if (choice == 0) {
+              install_remote_menu(api_themes_url, "Available Themes:",
+                                  cjsh_filesystem::g_cjsh_theme_path);
+            } else if (choice == 1) {
+              std::vector<cjsh_filesystem::fs::path> themes =
+                  installed_themes();
+              std::vector<std::string> names;
+              for (auto& theme : themes)
+                names.push_back(theme.filename().string());
+              size_t idx;
+              if (filter_pick("Uninstall Themes", names, names, idx)) {
+                cjsh_store::uninstall(themes[idx]);
+                clear();
+                mvprintw(0, 0, "Deleted %s. Press any key...",
+                         names[idx].c_str());
+                wait_key();
+              }
+            } else if (choice == 2) {
+              clean_store();
+            } else if (choice == (int)theme_menu.size() - 1) {
+              return false;
+            } else {
+              mvprintw(0, 0, "Not yet implemented. Press any key...");
+              wait_key();
+            }
+            break;
+        }
+        return true;
+      });
+  loop.remove_watch(watch);
 }
 
 static void list_plugins() {
@@ -380,87 +918,309 @@ static void list_plugins() {
       mvprintw(row++, 0, entry.path().filename().c_str());
   }
   mvprintw(row + 1, 0, "Press any key...");
-  getch();
+  wait_key();
+}
+
+static std::string plugin_summary(const plugin_inspector::PluginInfo& p) {
+  std::string line = p.path.filename().string() + "  " +
+                     (p.arch.empty() ? p.format : p.arch) + "  " +
+                     std::to_string((p.size + 1023) / 1024) + " KiB";
+  if (!p.entry_points.empty())
+    line += "  " + std::to_string(p.entry_points.size()) + " entry points";
+  return line;
+}
+
+static std::string join(const std::vector<std::string>& items) {
+  std::string out;
+  for (auto& item : items) out += (out.empty() ? "" : ", ") + item;
+  return out;
+}
+
+// why cjsh would fail to load the plugin, empty if it looks fine
+static std::string plugin_problem(const plugin_inspector::PluginInfo& p) {
+  if (!p.error.empty()) return p.error;
+  if (!p.arch_matches_host) return "built for " + p.arch;
+  if (!p.missing_entry_points.empty())
+    return "missing " + join(p.missing_entry_points);
+  if (!p.missing_deps.empty()) return "needs " + join(p.missing_deps);
+  return "";
 }
 
 static void managePlugins() {
+  auto& loop = EventLoop::instance();
   int choice = 0;
-  while (true) {
-    clear();
-    mvprintw(0, 0, "Manage Plugins");
-    {
-      int rows, cols;
-      getmaxyx(stdscr, rows, cols);
-      int list_col = cols / 2;
-      mvprintw(0, list_col, "Installed Plugins:");
-      int row = 1;
-      for (auto& entry : cjsh_filesystem::fs::directory_iterator(
-               cjsh_filesystem::g_cjsh_plugin_path)) {
-        auto ext = entry.path().extension().string();
-        if (ext == ".dylib" || ext == ".so")
-          mvprintw(row++, list_col, entry.path().filename().c_str());
-      }
-    }
-    for (size_t i = 0; i < plugin_menu.size(); ++i) {
-      if ((int)i == choice) attron(A_REVERSE);
-      mvprintw((int)i + 2, 2, plugin_menu[i].c_str());
-      if ((int)i == choice) attroff(A_REVERSE);
-    }
-    int c = getch();
-    switch (c) {
-      case KEY_UP:
-        choice = (choice + plugin_menu.size() - 1) % plugin_menu.size();
-        break;
-      case KEY_DOWN:
-        choice = (choice + 1) % plugin_menu.size();
-        break;
-      case '\n':
-        if (choice == 0) {
-          auto items = fetch_remote_list(api_plugins_url);
-          clear();
-          mvprintw(0, 0, "Available Plugins:");
+
+  // plugins are inspected on a worker so the screen never waits for it; only
+  // the newest run is shown and nothing is delivered after the screen closes
+  struct Inspection {
+    bool alive = true;
+    int generation = 0;
+    bool ready = false;
+    std::vector<plugin_inspector::PluginInfo> plugins;
+  };
+  auto inspection = std::make_shared<Inspection>();
+  auto start_inspection = [inspection, &loop]() {
+    int generation = ++inspection->generation;
+    run_in_background<std::vector<plugin_inspector::PluginInfo>>(
+        []() {
+          return plugin_inspector::inspect_directory(
+              cjsh_filesystem::g_cjsh_plugin_path);
+        },
+        [inspection, generation,
+         &loop](std::vector<plugin_inspector::PluginInfo> plugins) {
+          if (!inspection->alive || generation != inspection->generation)
+            return;
+          inspection->plugins = std::move(plugins);
+          inspection->ready = true;
+          loop.request_redraw();
+        });
+  };
+  start_inspection();
+  int watch = loop.add_watch(cjsh_filesystem::g_cjsh_plugin_path,
+                             [&loop, start_inspection]() {
+                               start_inspection();
+                               loop.request_redraw();
+                             });
+  loop.run(
+      [&]() {
+        clear();
+        mvprintw(0, 0, "Manage Plugins");
+        {
+          int rows, cols;
+          getmaxyx(stdscr, rows, cols);
+          int list_col = cols / 2;
+          int width = cols - list_col - 1;
+          mvprintw(0, list_col, "Installed Plugins:");
           int row = 1;
-          for (auto& name : items) mvprintw(row++, 0, name.c_str());
-          mvprintw(row + 1, 0, "Press any key...");
-          getch();
-        } else if (choice == 1) {
-          clear();
-          mvprintw(0, 0, "Uninstall Plugins:");
-          std::vector<cjsh_filesystem::fs::path> plugins;
-          for (auto& entry : cjsh_filesystem::fs::directory_iterator(
-                   cjsh_filesystem::g_cjsh_plugin_path)) {
-            auto ext = entry.path().extension().string();
-            if (ext == ".dylib" || ext == ".so")
-              plugins.push_back(entry.path());
-          }
-          for (size_t i = 0; i < plugins.size(); ++i)
-            mvprintw((int)i + 1, 0, "%zu) %s", i + 1,
-                     plugins[i].filename().c_str());
-          mvprintw((int)plugins.size() + 2, 0, "Select plugin #: ");
-          echo();
-          curs_set(1);
-          char num[16];
-          getnstr(num, 15);
-          noecho();
-          curs_set(0);
-          int idx = atoi(num) - 1;
-          if (idx >= 0 && idx < (int)plugins.size()) {
-            cjsh_filesystem::fs::remove(plugins[idx]);
-            mvprintw((int)plugins.size() + 4, 0, "Deleted. Press any key...");
+          if (inspection->ready) {
+            for (auto& p : inspection->plugins) {
+              mvprintw(row++, list_col, "%s",
+                       plugin_summary(p).substr(0, width).c_str());
+              std::string problem = plugin_problem(p);
+              if (!problem.empty())
+                mvprintw(row++, list_col, "%s",
+                         ("  ! " + problem).substr(0, width).c_str());
+            }
           } else {
-            mvprintw((int)plugins.size() + 4, 0,
-                     "Invalid selection. Press any key...");
+            for (auto& entry : cjsh_filesystem::fs::directory_iterator(
+                     cjsh_filesystem::g_cjsh_plugin_path)) {
+              auto ext = entry.path().extension().string();
+              if (ext == ".dylib" || ext == ".so")
+                mvprintw(row++, list_col, entry.path().filename().c_str());
+            }
+            mvprintw(row, list_col, "(inspecting...)");
           }
-          getch();
-        } else if (choice == (int)plugin_menu.size() - 1) {
-          return;
-        } else {
-          mvprintw(0, 0, "Not yet implemented. Press any key...");
-          getch();
         }
-        break;
-    }
+        for (size_t i = 0; i < plugin_menu.size(); ++i) {
+          if ((int)i == choice) attron(A_REVERSE);
+          mvprintw((int)i + 2, 2, plugin_menu[i].c_str());
+          if ((int)i == choice) attroff(A_REVERSE);
+        }
+      },
+      [&](int c) {
+        switch (c) {
+          case KEY_UP:
+            choice = (choice + plugin_menu.size() - 1) % plugin_menu.size();
+            break;
+          case KEY_DOWN:
+            choice = (choice + 1) % plugin_menu.size();
+            break;
+          case '\n':
+            if (choice == 0) {
+              install_remote_menu(api_plugins_url, "Available Plugins:",
+                                  cjsh_filesystem::g_cjsh_plugin_path);
+            } else if (choice == 1) {
+              std::vector<cjsh_filesystem::fs::path> plugins;
+              for (auto& entry : cjsh_filesystem::fs::directory_iterator(
+                       cjsh_filesystem::g_cjsh_plugin_path)) {
+                auto ext = entry.path().extension().string();
+                if (ext == ".dylib" || ext == ".so")
+                  plugins.push_back(entry.path());
+              }
+              std::sort(plugins.begin(), plugins.end());
+              std::vector<std::string> names;
+              for (auto& plugin : plugins)
+                names.push_back(plugin.filename().string());
+              size_t idx;
+              if (filter_pick("Uninstall Plugins", names, names, idx)) {
+                cjsh_store::uninstall(plugins[idx]);
+                clear();
+                mvprintw(0, 0, "Deleted %s. Press any key...",
+                         names[idx].c_str());
+                wait_key();
+              }
+            } else if (choice == 2) {
+              clean_store();
+            } else if (choice == (int)plugin_menu.size() - 1) {
+              return false;
+            } else {
+              mvprintw(0, 0, "Not yet implemented. Press any key...");
+              wait_key();
+            }
+            break;
+        }
+        return true;
+      });
+  loop.remove_watch(watch);
+  inspection->alive = false;
+}
+
+static std::string read_file(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+static std::vector<std::string> split_lines(const std::string& text) {
+  std::vector<std::string> lines;
+  std::istringstream iss(text);
+  std::string l;
+  while (std::getline(iss, l)) lines.push_back(l);
+  return lines;
+}
+
+// unified diff of the working copy against orig_path with every hunk
+// accepted or rejected on its own. writes the result and returns true when
+// saved, false when the changes are discarded
+static bool review_changes(const std::string& orig_path,
+                           const std::string& temp_path) {
+  std::string old_text = read_file(orig_path);
+  std::string new_text = read_file(temp_path);
+  std::vector<std::string> old_lines = split_lines(old_text);
+  std::vector<std::string> new_lines = split_lines(new_text);
+  std::vector<line_diff::Hunk> hunks = line_diff::diff(old_lines, new_lines);
+
+  if (hunks.empty()) {
+    // only the final newline differs, nothing to pick from
+    clear();
+    mvprintw(0, 0, "Save changes? (y/n)");
+    int c = wait_key();
+    if (c != 'y' && c != 'Y') return false;
+    cjsh_filesystem::fs::copy_file(
+        temp_path, orig_path,
+        cjsh_filesystem::fs::copy_options::overwrite_existing);
+    return true;
+  }
+
+  // one row per hunk header and diff line, hunk_rows[h] is the header row
+  struct Row {
+    size_t hunk;
+    const std::string* text;
+  };
+  std::vector<Row> rows;
+  std::vector<size_t> hunk_rows;
+  std::vector<std::string> headers;
+  headers.reserve(hunks.size());
+  for (auto& hunk : hunks) headers.push_back(hunk.header());
+  for (size_t h = 0; h < hunks.size(); ++h) {
+    hunk_rows.push_back(rows.size());
+    rows.push_back({h, &headers[h]});
+    for (auto& line : hunks[h].lines) rows.push_back({h, &line});
+  }
+  std::vector<bool> accepted(hunks.size(), true);
+  size_t top = 0;
+  bool save = false;
+  if (has_colors()) {
+    init_pair(1, COLOR_RED, -1);
+    init_pair(2, COLOR_GREEN, -1);
+    init_pair(3, COLOR_CYAN, -1);
+  }
+
+  auto& loop = EventLoop::instance();
+  auto page = []() { return (size_t)std::max(1, LINES - 3); };
+  loop.run(
+      [&]() {
+        clear();
+        size_t current = rows[top].hunk;
+        size_t taken = std::count(accepted.begin(), accepted.end(), true);
+        mvprintw(0, 0, "Review changes to %s  hunk %zu/%zu, %zu accepted",
+                 cjsh_filesystem::fs::path(orig_path).filename().c_str(),
+                 current + 1, hunks.size(), taken);
+        for (size_t r = top; r < rows.size() && r - top < page(); ++r) {
+          const Row& row = rows[r];
+          std::string text = *row.text;
+          short pair = 0;
+          if (r == hunk_rows[row.hunk]) {
+            text += accepted[row.hunk] ? "  [accept]" : "  [reject]";
+            pair = 3;
+          } else if (text[0] == '-') {
+            pair = 1;
+          } else if (text[0] == '+') {
+            pair = 2;
+          }
+          int attrs = COLOR_PAIR(pair);
+          if (row.hunk == current) attrs |= A_BOLD;
+          if (!accepted[row.hunk] && r != hunk_rows[row.hunk]) attrs = A_DIM;
+          attron(attrs);
+          mvprintw((int)(r - top) + 1, 0, "%s",
+                   text.substr(0, std::max(0, COLS - 1)).c_str());
+          attroff(attrs);
+        }
+        mvprintw(LINES - 1, 0,
+                 "space toggle  n/p hunk  a/r all  s save  q discard");
+      },
+      [&](int c) {
+        size_t current = rows[top].hunk;
+        switch (c) {
+          case KEY_UP:
+            if (top > 0) --top;
+            break;
+          case KEY_DOWN:
+            if (top + 1 < rows.size()) ++top;
+            break;
+          case KEY_PPAGE:
+            top -= std::min(top, page());
+            break;
+          case KEY_NPAGE:
+            top = std::min(rows.size() - 1, top + page());
+            break;
+          case 'n':
+            if (current + 1 < hunks.size()) top = hunk_rows[current + 1];
+            break;
+          case 'p':
+            if (top != hunk_rows[current])
+              top = hunk_rows[current];
+            else if (current > 0)
+              top = hunk_rows[current - 1];
+            break;
+          case ' ':
+            accepted[current] = !accepted[current];
+            break;
+          case 'a':
+          case 'A':
+            accepted.assign(hunks.size(), true);
+            break;
+          case 'r':
+          case 'R':
+            accepted.assign(hunks.size(), false);
+            break;
+          case 's':
+          case '\n':
+            save = true;
+            return false;
+          case 'q':
+          case 27:
+            return false;
+        }
+        return true;
+      });
+  if (!save) return false;
+
+  std::vector<std::string> merged =
+      line_diff::apply(old_lines, new_lines, hunks, accepted);
+  // the final newline follows whichever side the last line came from
+  const line_diff::Hunk& last = hunks.back();
+  bool last_from_new = accepted.back() &&
+                       last.old_start + last.old_count == old_lines.size();
+  const std::string& tail_text = last_from_new ? new_text : old_text;
+  bool final_newline = !tail_text.empty() && tail_text.back() == '\n';
+  std::ofstream ofs(orig_path, std::ios::binary | std::ios::trunc);
+  for (size_t i = 0; i < merged.size(); ++i) {
+    ofs << merged[i];
+    if (i + 1 < merged.size() || final_newline) ofs << '\n';
   }
+  return true;
 }
 
 static void configureFile(const std::string& orig_path,
@@ -470,116 +1230,141 @@ static void configureFile(const std::string& orig_path,
       orig_path, temp_path,
       cjsh_filesystem::fs::copy_options::overwrite_existing);
   std::string path = temp_path;
-  bool exitLoop = false;
   int choice = 0;
-  while (true) {
-    clear();
-    {
-      std::vector<std::string> lines;
-      std::ifstream ifs(path);
-      std::string l;
-      while (std::getline(ifs, l)) lines.push_back(l);
-      int rows, cols;
-      getmaxyx(stdscr, rows, cols);
-      int preview_col = cols / 2;
-      mvprintw(1, preview_col, "Preview:");
-      for (size_t i = 0; i < lines.size() && (int)i < rows - 3; ++i) {
-        mvprintw((int)i + 2, preview_col,
-                 lines[i].substr(0, cols - preview_col - 1).c_str());
-      }
-    }
 
-    mvprintw(0, 0, ("Configure " + path).c_str());
-    for (size_t i = 0; i < edit_items.size(); ++i) {
-      if ((int)i == choice) attron(A_REVERSE);
-      mvprintw((int)i + 2, 2, edit_items[i].c_str());
-      if ((int)i == choice) attroff(A_REVERSE);
+  auto& loop = EventLoop::instance();
+  // contents of orig_path as last copied into the working copy
+  std::string synced = read_file(orig_path);
+  bool changed_on_disk = false;
+  int temp_watch =
+      loop.add_watch(temp_path, [&loop]() { loop.request_redraw(); });
+  int orig_watch = loop.add_watch(orig_path, [&]() {
+    std::string current = read_file(orig_path);
+    if (current == synced) return;
+    if (read_file(temp_path) == synced) {
+      // nothing edited here yet, follow the external change
+      cjsh_filesystem::fs::copy_file(
+          orig_path, temp_path,
+          cjsh_filesystem::fs::copy_options::overwrite_existing);
+      synced = current;
+    } else {
+      changed_on_disk = true;
     }
-    int c = getch();
-    switch (c) {
-      case KEY_UP:
-        choice = (choice + edit_items.size() - 1) % edit_items.size();
-        break;
-      case KEY_DOWN:
-        choice = (choice + 1) % edit_items.size();
-        break;
-      case '\n': {
-        int exit_idx = edit_items.size() - 1;
-        int wipe_idx = edit_items.size() - 2;
-        int remove_idx = edit_items.size() - 3;
-        if (choice == exit_idx) {
-          exitLoop = true;
-          break;
-        }
-        if (choice == wipe_idx) {
-          std::ofstream ofs(path);
-          clear();
-          mvprintw(0, 0, "File wiped. Press any key...");
-          getch();
-          continue;
-        }
-        if (choice == remove_idx) {
+    loop.request_redraw();
+  });
+
+  loop.run(
+      [&]() {
+        clear();
+        {
           std::vector<std::string> lines;
-          std::ifstream ifs2(path);
+          std::ifstream ifs(path);
           std::string l;
-          while (std::getline(ifs2, l)) lines.push_back(l);
-          clear();
-          for (size_t i = 0; i < lines.size(); ++i)
-            mvprintw((int)i, 0, "%zu: %s", i + 1, lines[i].c_str());
-          mvprintw((int)lines.size() + 1, 0, "Line # to remove: ");
-          echo();
-          curs_set(1);
-          char num[16];
-          getnstr(num, 15);
-          int idx = atoi(num) - 1;
-          if (idx >= 0 && idx < (int)lines.size())
-            lines.erase(lines.begin() + idx);
-          std::ofstream ofs2(path);
-          for (auto& ln : lines) ofs2 << ln << "\n";
-          noecho();
-          curs_set(0);
-          mvprintw((int)lines.size() + 3, 0, "Removed. Press any key...");
-          getch();
-        } else {
-          if (path.find(".cjshrc") != std::string::npos) {
-            switch (choice) {
-              case 0:
-                add_alias_menu(path);
-                break;
-              case 1:
-                add_startup_command_menu(path);
-                break;
-              case 2:
-                add_env_var_menu(path);
-                break;
-              case 3:
-                add_theme_menu(path);
-                break;
-              case 4:
-                add_plugin_menu(path);
-                break;
+          while (std::getline(ifs, l)) lines.push_back(l);
+          int rows, cols;
+          getmaxyx(stdscr, rows, cols);
+          int preview_col = cols / 2;
+          mvprintw(1, preview_col, "Preview:");
+          for (size_t i = 0; i < lines.size() && (int)i < rows - 3; ++i) {
+            mvprintw((int)i + 2, preview_col,
+                     lines[i].substr(0, cols - preview_col - 1).c_str());
+          }
+        }
+
+        mvprintw(0, 0, ("Configure " + path).c_str());
+        for (size_t i = 0; i < edit_items.size(); ++i) {
+          if ((int)i == choice) attron(A_REVERSE);
+          mvprintw((int)i + 2, 2, edit_items[i].c_str());
+          if ((int)i == choice) attroff(A_REVERSE);
+        }
+        if (changed_on_disk)
+          mvprintw((int)edit_items.size() + 3, 2,
+                   "%s was changed by another program",
+                   cjsh_filesystem::fs::path(orig_path).filename().c_str());
+      },
+      [&](int c) {
+        switch (c) {
+          case KEY_UP:
+            choice = (choice + edit_items.size() - 1) % edit_items.size();
+            break;
+          case KEY_DOWN:
+            choice = (choice + 1) % edit_items.size();
+            break;
+          case '\n': {
+            int exit_idx = edit_items.size() - 1;
+            int wipe_idx = edit_items.size() - 2;
+            int remove_idx = edit_items.size() - 3;
+            if (choice == exit_idx) return false;
+            if (choice == wipe_idx) {
+              std::ofstream ofs(path);
+              clear();
+              mvprintw(0, 0, "File wiped. Press any key...");
+              wait_key();
+              return true;
             }
-          } else if (path.find(".cjprofile") != std::string::npos) {
-            switch (choice) {
-              case 0:
-                add_alias_menu(path);
-                break;
-              case 1:
-                add_startup_command_menu(path);
-                break;
-              case 2:
-                add_env_var_menu(path);
-                break;
-              case 3:
-                add_startup_arg(path);
-                break;
+            if (choice == remove_idx) {
+              std::vector<std::string> lines = split_lines(read_file(path));
+              std::vector<std::string> labels;
+              labels.reserve(lines.size());
+              for (size_t i = 0; i < lines.size(); ++i)
+                labels.push_back(std::to_string(i + 1) + ": " + lines[i]);
+              size_t idx;
+              if (filter_pick("Remove line", lines, labels, idx)) {
+                lines.erase(lines.begin() + idx);
+                std::ofstream ofs2(path);
+                for (auto& ln : lines) ofs2 << ln << "\n";
+                clear();
+                mvprintw(0, 0, "Removed line %zu. Press any key...", idx + 1);
+                wait_key();
+              }
+            } else {
+              if (path.find(".cjshrc") != std::string::npos) {
+                switch (choice) {
+                  case 0:
+                    add_alias_menu(path);
+                    break;
+                  case 1:
+                    add_startup_command_menu(path);
+                    break;
+                  case 2:
+                    add_env_var_menu(path);
+                    break;
+                  case 3:
+                    add_theme_menu(path);
+                    break;
+                  case 4:
+                    add_plugin_menu(path);
+                    break;
+                  case 5:
+                    suggest_aliases_menu(path);
+                    break;
+                }
+              } else if (path.find(".cjprofile") != std::string::npos) {
+                switch (choice) {
+                  case 0:
+                    add_alias_menu(path);
+                    break;
+                  case 1:
+                    add_startup_command_menu(path);
+                    break;
+                  case 2:
+                    add_env_var_menu(path);
+                    break;
+                  case 3:
+                    add_startup_arg(path);
+                    break;
+                  case 4:
+                    suggest_aliases_menu(path);
+                    break;
+                }
+              }
             }
-          }
+          } break;
         }
-      } break;
-    }
-    if (exitLoop) break;
-  }
+        return true;
+      });
+  loop.remove_watch(temp_watch);
+  loop.remove_watch(orig_watch);
 
   bool changed = false;
   {
@@ -595,16 +1380,8 @@ static void configureFile(const std::string& orig_path,
     if (!changed && (orig_fs.get(c1) || tmp_fs.get(c2))) changed = true;
   }
 
-  if (changed) {
-    clear();
-    mvprintw(0, 0, "Save changes? (y/n)");
-    int c = getch();
-    if (c == 'y' || c == 'Y') {
-      cjsh_filesystem::fs::copy_file(
-          temp_path, orig_path,
-          cjsh_filesystem::fs::copy_options::overwrite_existing);
-    }
-  }
+  if (changed && review_changes(orig_path, temp_path))
+    cjsh_snapshot::compile();
 
   cjsh_filesystem::fs::remove(temp_path);
 }
@@ -614,52 +1391,61 @@ void Configurator::run() {
   noecho();
   cbreak();
   keypad(stdscr, TRUE);
+  if (has_colors()) {
+    start_color();
+    use_default_colors();
+  }
 
   int choice = 0;
   std::string rc = cjsh_filesystem::g_cjsh_source_path.string();
   std::string profile = cjsh_filesystem::g_cjsh_profile_path.string();
 
-  while (true) {
-    clear();
-    {
-      int rows, cols;
-      getmaxyx(stdscr, rows, cols);
-      int splash_col = cols / 2;
-      for (size_t i = 0; i < splash.size() && (int)i < rows; ++i)
-        mvprintw((int)i, splash_col, splash[i].c_str());
-    }
-    mvprintw(0, 0, "CJ's Shell Configurator");
-    mvprintw(1, 0, ("Version: " + version).c_str());
-    for (size_t i = 0; i < main_menu.size(); ++i) {
-      if ((int)i == choice) attron(A_REVERSE);
-      mvprintw((int)i + 3, 2, main_menu[i].c_str());
-      if ((int)i == choice) attroff(A_REVERSE);
-    }
-    int c = getch();
-    switch (c) {
-      case KEY_UP:
-        choice = (choice + main_menu.size() - 1) % main_menu.size();
-        break;
-      case KEY_DOWN:
-        choice = (choice + 1) % main_menu.size();
-        break;
-      case '\n':
-        endwin();
-        if (choice == 0) {
-          configureFile(rc, edit_items_cjshrc);
-        } else if (choice == 1) {
-          configureFile(profile, edit_items_cjprofile);
-        } else if (choice == 2) {
-          manageThemes();
-        } else if (choice == 3) {
-          managePlugins();
-        } else if (choice == 4) {
-          return;
+  EventLoop::instance().run(
+      [&]() {
+        clear();
+        {
+          int rows, cols;
+          getmaxyx(stdscr, rows, cols);
+          int splash_col = cols / 2;
+          for (size_t i = 0; i < splash.size() && (int)i < rows; ++i)
+            mvprintw((int)i, splash_col, splash[i].c_str());
         }
-        initscr();
-        break;
-    }
-  }
+        mvprintw(0, 0, "CJ's Shell Configurator");
+        mvprintw(1, 0, ("Version: " + version).c_str());
+        for (size_t i = 0; i < main_menu.size(); ++i) {
+          if ((int)i == choice) attron(A_REVERSE);
+          mvprintw((int)i + 3, 2, main_menu[i].c_str());
+          if ((int)i == choice) attroff(A_REVERSE);
+        }
+      },
+      [&](int c) {
+        switch (c) {
+          case KEY_UP:
+            choice = (choice + main_menu.size() - 1) % main_menu.size();
+            break;
+          case KEY_DOWN:
+            choice = (choice + 1) % main_menu.size();
+            break;
+          case '\n':
+            endwin();
+            if (choice == 0) {
+              configureFile(rc, edit_items_cjshrc);
+            } else if (choice == 1) {
+              configureFile(profile, edit_items_cjprofile);
+            } else if (choice == 2) {
+              manageThemes();
+            } else if (choice == 3) {
+              managePlugins();
+            } else if (choice == 4) {
+              return false;
+            }
+            initscr();
+            break;
+        }
+        return true;
+      });
+  // workers must be gone before main returns and statics are destroyed
+  EventLoop::instance().shutdown();
 }
 
 }  // namespace tui
@@ -0,0 +1,160 @@
+// timing benchmark for line_diff. diffs a generated rc file against edited
+// copies, including the inputs that defeat Myers (shuffled, reversed,
+// sorted, rotated, and two files of the same few lines in random order),
+// and checks that the hunks rebuild either file
+//
+//   cjsh-diff-bench [--lines n] [--runs n] [--max-ms ms]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/line_diff.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+  int lines = 50000;
+  int runs = 3;
+  double max_ms = 0;  // 0 to only report
+};
+
+using Lines = std::vector<std::string>;
+
+struct Case {
+  const char* name;
+  Lines old_lines;
+  Lines new_lines;
+};
+
+// the same mix of lines the configurator sees in a generated rc file
+Lines make_rc(int lines) {
+  Lines rc;
+  rc.reserve(lines);
+  for (int i = 0; i < lines; ++i) {
+    std::string n = std::to_string(i);
+    switch (i % 4) {
+      case 0:
+        rc.push_back("alias a" + n + "='git log --oneline -n " + n + "'");
+        break;
+      case 1:
+        rc.push_back("export BENCH_VAR_" + n + "=value" + n);
+        break;
+      case 2:
+        rc.push_back("# generated line " + n);
+        break;
+      default:
+        rc.push_back("echo startup " + n);
+    }
+  }
+  return rc;
+}
+
+std::vector<Case> cases(const Lines& rc) {
+  std::mt19937 rng(42);
+  std::vector<Case> out;
+
+  Lines edited = rc;
+  for (size_t i = 0; i < edited.size() / 50; ++i)
+    edited[rng() % edited.size()] = "echo edited " + std::to_string(i);
+  edited.insert(edited.begin() + edited.size() / 3, "theme load bench0");
+  edited.erase(edited.begin() + edited.size() / 2);
+  out.push_back({"2% edited", rc, edited});
+
+  Lines disjoint;
+  for (size_t i = 0; i < rc.size(); ++i)
+    disjoint.push_back("echo other " + std::to_string(rng()));
+  out.push_back({"disjoint", rc, disjoint});
+
+  Lines shuffled = rc;
+  std::shuffle(shuffled.begin(), shuffled.end(), rng);
+  out.push_back({"shuffled", rc, shuffled});
+
+  out.push_back({"reversed", rc, Lines(rc.rbegin(), rc.rend())});
+
+  Lines sorted = rc;
+  std::sort(sorted.begin(), sorted.end());
+  out.push_back({"sorted", rc, sorted});
+
+  Lines rotated = rc;
+  std::rotate(rotated.begin(), rotated.begin() + rotated.size() / 3,
+              rotated.end());
+  out.push_back({"rotated", rc, rotated});
+
+  // no line is unique, so nothing anchors the diff
+  const Lines common = {"", "fi", "done", "}", "  fi", "esac", "else"};
+  Lines repeated_old, repeated_new;
+  for (size_t i = 0; i < rc.size(); ++i) {
+    repeated_old.push_back(common[rng() % common.size()]);
+    repeated_new.push_back(common[rng() % common.size()]);
+  }
+  out.push_back({"repeated", repeated_old, repeated_new});
+  return out;
+}
+
+bool parse_args(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    std::string value = argv[++i];
+    if (arg == "--lines")
+      options.lines = std::max(1, std::atoi(value.c_str()));
+    else if (arg == "--runs")
+      options.runs = std::max(1, std::atoi(value.c_str()));
+    else if (arg == "--max-ms")
+      options.max_ms = std::atof(value.c_str());
+    else
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parse_args(argc, argv, options)) {
+    std::fprintf(stderr, "usage: %s [--lines n] [--runs n] [--max-ms ms]\n",
+                 argv[0]);
+    return 2;
+  }
+  Lines rc = make_rc(options.lines);
+  std::printf("%d lines, %d runs\n\n", options.lines, options.runs);
+  std::printf("%-12s %8s %8s %8s\n", "case", "hunks", "changed", "best ms");
+
+  bool ok = true;
+  for (const Case& c : cases(rc)) {
+    double best = 0;
+    std::vector<line_diff::Hunk> hunks;
+    for (int run = 0; run < options.runs; ++run) {
+      auto start = Clock::now();
+      hunks = line_diff::diff(c.old_lines, c.new_lines);
+      double ms =
+          std::chrono::duration<double, std::milli>(Clock::now() - start)
+              .count();
+      if (run == 0 || ms < best) best = ms;
+    }
+    size_t changed = 0;
+    for (auto& h : hunks)
+      for (auto& line : h.lines)
+        if (line[0] != ' ') ++changed;
+    std::printf("%-12s %8zu %8zu %8.2f\n", c.name, hunks.size(), changed,
+                best);
+    std::vector<bool> all(hunks.size(), true), none(hunks.size(), false);
+    if (line_diff::apply(c.old_lines, c.new_lines, hunks, all) !=
+            c.new_lines ||
+        line_diff::apply(c.old_lines, c.new_lines, hunks, none) !=
+            c.old_lines) {
+      std::printf("%-12s hunks do not apply\n", c.name);
+      ok = false;
+    }
+    if (options.max_ms > 0 && best > options.max_ms) ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+// frame time benchmark for cjsh-configure. runs the configurator on a
+// pseudo terminal against a generated home directory, replays scripted keys
+// and reports how long each key takes to be fully drawn and how many bytes
+// the redraw sent to the terminal
+//
+//   cjsh-configure-bench [--binary path] [--lines n] [--themes n]
+//                        [--plugins n] [--runs n] [--max-p95 ms]
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+  std::string binary;
+  int lines = 50000;
+  int themes = 500;
+  int plugins = 200;
+  int runs = 3;
+  double max_p95 = 0;  // ms, 0 to only report
+  int quiet_ms = 30;   // output idle this long ends a frame
+  int timeout_ms = 5000;
+};
+
+struct Scenario {
+  const char* name;
+  std::vector<std::string> setup;  // keys sent before measuring
+  std::vector<std::string> keys;
+};
+
+const std::string kUp = "\x1bOA";  // keypad mode, as ncurses enables it
+const std::string kDown = "\x1bOB";
+const std::string kEnter = "\r";
+
+std::vector<std::string> repeat(const std::string& key, int n) {
+  return std::vector<std::string>(n, key);
+}
+
+std::vector<std::string> concat(std::vector<std::string> a,
+                                const std::vector<std::string>& b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+std::vector<Scenario> scenarios() {
+  return {
+      {"main menu", {}, concat(repeat(kDown, 10), repeat(kUp, 5))},
+      {"edit .cjshrc", {kEnter}, concat(repeat(kDown, 10), repeat(kUp, 5))},
+      {"edit .cjprofile", {kDown, kEnter}, repeat(kDown, 10)},
+      {"theme picker",
+       {kEnter, kDown, kDown, kDown, kEnter},
+       concat(repeat(kDown, 20), repeat(kUp, 10))},
+      {"manage themes", {kDown, kDown, kEnter}, repeat(kDown, 8)},
+      {"manage plugins", {kDown, kDown, kDown, kEnter}, repeat(kDown, 8)},
+  };
+}
+
+void write_file(const fs::path& path, const std::string& text) {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs << text;
+}
+
+// a home with a large rc file and crowded theme and plugin directories
+fs::path make_home(const Options& options) {
+  char tmpl[] = "/tmp/cjsh-bench.XXXXXX";
+  if (!mkdtemp(tmpl)) return {};
+  fs::path home = tmpl;
+  fs::path data = home / ".config" / "cjsh";
+  fs::create_directories(data / "themes");
+  fs::create_directories(data / "plugins");
+  fs::create_directories(data / "colors");
+  fs::create_directories(home / ".cache" / "cjsh");
+
+  std::string rc;
+  for (int i = 0; i < options.lines; ++i) {
+    switch (i % 4) {
+      case 0:
+        rc += "alias a" + std::to_string(i) + "='git log --oneline -n " +
+              std::to_string(i) + "'\n";
+        break;
+      case 1:
+        rc += "export BENCH_VAR_" + std::to_string(i) + "=value" +
+              std::to_string(i) + "\n";
+        break;
+      case 2:
+        rc += "# generated line " + std::to_string(i) + "\n";
+        break;
+      default:
+        rc += "echo startup " + std::to_string(i) + "\n";
+    }
+  }
+  rc += "theme load bench0\n";
+  write_file(home / ".cjshrc", rc);
+  write_file(home / ".cjprofile", rc.substr(0, rc.size() / 10));
+
+  for (int t = 0; t < options.themes; ++t) {
+    write_file(data / "themes" / ("bench" + std::to_string(t) + ".json"),
+               "{\"ps1_segments\": [\n"
+               "  {\"content\": \"{USERNAME}@{HOSTNAME}\", \"fg_color\": "
+               "\"#ffffff\", \"bg_color\": \"#005f87\", \"separator\": \" \", "
+               "\"separator_fg\": \"#005f87\", \"separator_bg\": \"RESET\"},\n"
+               "  {\"content\": \"{PATH}\", \"fg_color\": \"BRIGHT_GREEN\", "
+               "\"bg_color\": \"RESET\"}\n]}\n");
+  }
+  std::string junk(4096, '\0');
+  for (int p = 0; p < options.plugins; ++p)
+    write_file(data / "plugins" / ("bench" + std::to_string(p) + ".so"),
+               junk);
+  return home;
+}
+
+class Session {
+ public:
+  Session(const Options& options, const fs::path& home) : options_(options) {
+    struct winsize ws = {};
+    ws.ws_row = 40;
+    ws.ws_col = 120;
+    pid_ = forkpty(&fd_, nullptr, nullptr, &ws);
+    if (pid_ == 0) {
+      setenv("HOME", home.c_str(), 1);
+      setenv("TERM", "xterm-256color", 1);
+      execl(options.binary.c_str(), options.binary.c_str(), (char*)nullptr);
+      _exit(127);
+    }
+  }
+
+  ~Session() {
+    if (pid_ > 0) {
+      kill(pid_, SIGKILL);
+      waitpid(pid_, nullptr, 0);
+    }
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool ok() const { return pid_ > 0 && fd_ >= 0; }
+
+  // sends key and reads until the terminal has been idle for quiet_ms.
+  // latency ends at the last byte of the frame, not at the idle timeout
+  bool press(const std::string& key, double& latency_ms, size_t& bytes) {
+    auto sent = Clock::now();
+    if (!key.empty() && write(fd_, key.data(), key.size()) < 0) return false;
+    return drain(sent, latency_ms, bytes);
+  }
+
+ private:
+  bool drain(Clock::time_point since, double& latency_ms, size_t& bytes) {
+    bytes = 0;
+    auto last = since;
+    char buf[65536];
+    int wait_ms = options_.timeout_ms;
+    for (;;) {
+      struct pollfd pfd = {fd_, POLLIN, 0};
+      int n = poll(&pfd, 1, wait_ms);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      ssize_t got = read(fd_, buf, sizeof(buf));
+      if (got <= 0) return false;  // the configurator exited
+      bytes += (size_t)got;
+      last = Clock::now();
+      wait_ms = options_.quiet_ms;
+    }
+    latency_ms =
+        std::chrono::duration<double, std::milli>(last - since).count();
+    return true;
+  }
+
+  const Options& options_;
+  pid_t pid_ = -1;
+  int fd_ = -1;
+};
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = (size_t)(p * (double)(v.size() - 1) + 0.5);
+  return v[std::min(i, v.size() - 1)];
+}
+
+bool parse_args(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    std::string value = argv[++i];
+    if (arg == "--binary")
+      options.binary = value;
+    else if (arg == "--lines")
+      options.lines = std::atoi(value.c_str());
+    else if (arg == "--themes")
+      options.themes = std::atoi(value.c_str());
+    else if (arg == "--plugins")
+      options.plugins = std::atoi(value.c_str());
+    else if (arg == "--runs")
+      options.runs = std::max(1, std::atoi(value.c_str()));
+    else if (arg == "--max-p95")
+      options.max_p95 = std::atof(value.c_str());
+    else
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parse_args(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: %s [--binary path] [--lines n] [--themes n] "
+                 "[--plugins n] [--runs n] [--max-p95 ms]\n",
+                 argv[0]);
+    return 2;
+  }
+  if (options.binary.empty())
+    options.binary =
+        (fs::path(argv[0]).parent_path() / "cjsh-configure").string();
+  fs::path home = make_home(options);
+  if (home.empty()) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+  std::printf("%d rc lines, %d themes, %d plugins, %d runs\n\n",
+              options.lines, options.themes, options.plugins, options.runs);
+  std::printf("%-16s %6s %9s %9s %9s %11s %12s\n", "scenario", "keys",
+              "p50 ms", "p95 ms", "max ms", "bytes/key", "first frame");
+
+  bool within_budget = true;
+  for (const Scenario& scenario : scenarios()) {
+    std::vector<double> latencies;
+    double startup = 0;
+    size_t total_bytes = 0;
+    bool failed = false;
+    for (int run = 0; run < options.runs && !failed; ++run) {
+      Session session(options, home);
+      double ms;
+      size_t bytes;
+      if (!session.ok() || !session.press("", ms, bytes)) {
+        failed = true;
+        break;
+      }
+      startup = std::max(startup, ms);
+      for (auto& key : scenario.setup)
+        if (!session.press(key, ms, bytes)) failed = true;
+      for (auto& key : scenario.keys) {
+        if (failed || !session.press(key, ms, bytes)) {
+          failed = true;
+          break;
+        }
+        latencies.push_back(ms);
+        total_bytes += bytes;
+      }
+    }
+    if (failed) {
+      std::printf("%-16s configurator exited early\n", scenario.name);
+      within_budget = false;
+      continue;
+    }
+    double p95 = percentile(latencies, 0.95);
+    std::printf("%-16s %6zu %9.2f %9.2f %9.2f %11zu %9.2f ms\n", scenario.name,
+                latencies.size(), percentile(latencies, 0.5), p95,
+                percentile(latencies, 1.0),
+                total_bytes / std::max<size_t>(1, latencies.size()), startup);
+    if (options.max_p95 > 0 && p95 > options.max_p95) {
+      std::printf("%-16s p95 over the %.2f ms budget\n", scenario.name,
+                  options.max_p95);
+      within_budget = false;
+    }
+  }
+
+  std::error_code ec;
+  fs::remove_all(home, ec);
+  return within_budget ? 0 : 1;
+}